@@ -0,0 +1,391 @@
+#ifndef ARENA_ALLOCATOR_H
+#define ARENA_ALLOCATOR_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/mman.h>
+
+// Arena allocator: the First Fit and Best Fit placement of the simulator as a real allocator, handing
+// out pieces of a byte arena supplied by the caller or mapped with mmap. Header only, with no other
+// dependencies, and it never calls malloc, so it can sit under the allocator of a service.
+//
+// The arena is split into granules of the configured alignment, and every block (allocated or free) is
+// a whole number of granules. Each block has a small header with its size and the size of the block
+// before it, so a freed block is merged right away with the free blocks at both sides, as the simulator
+// merges holes. The headers live in the arena right before every allocation (in-band), or in a table of
+// their own outside it (side table) when the arena must only hold user data; the side table takes
+// sizeof(ArenaBlock) bytes per granule, so it suits big alignments.
+//
+// First Fit keeps the free blocks in address order and takes the first one that fits. Best Fit keeps
+// them in size classes (exact sizes up to 64 granules, then 32 classes per power of two) and takes the
+// smallest block that fits, the most recently freed one among equally sized blocks.
+//
+// An arena is not thread safe: use one per thread, or a lock around it.
+
+const int ARENA_FIRST_FIT = 0;
+const int ARENA_BEST_FIT = 1;
+
+const int ARENA_IN_BAND_HEADERS = 0;
+const int ARENA_SIDE_TABLE_HEADERS = 1;
+
+const uint32_t ARENA_NO_BLOCK = UINT32_MAX;
+const uint32_t ARENA_FREE_BLOCK = 0x80000000u;   // Flag in ArenaBlock::size
+const uint32_t ARENA_MAXIMUM_GRANULES = 0x7fffffffu;
+
+const int ARENA_EXACT_BIN_COUNT = 64;            // Free blocks under 64 granules: one class per size
+const int ARENA_SUBBIN_BITS = 5;                 // Bigger ones: 32 classes per power of two
+const int ARENA_BIN_COUNT = ARENA_EXACT_BIN_COUNT + (31 - 6) * (1 << ARENA_SUBBIN_BITS);
+const int ARENA_BITMAP_WORDS = (ARENA_BIN_COUNT + 63) / 64;
+
+// Header of a block. Sizes are in granules, and blocks are named by their first granule.
+struct ArenaBlock{
+    uint32_t size;          // Header included, with ARENA_FREE_BLOCK while free
+    uint32_t previousSize;  // Size of the block right before it in the arena, 0 for the first one
+    uint32_t nextFree;      // Free list links, only meaningful while free
+    uint32_t previousFree;
+};
+
+struct ArenaOptions{
+    int placement;     // ARENA_FIRST_FIT or ARENA_BEST_FIT
+    int headers;       // ARENA_IN_BAND_HEADERS or ARENA_SIDE_TABLE_HEADERS
+    size_t alignment;  // Of every allocation: a power of two from 8 to 65536
+};
+
+struct ArenaAllocator{
+    unsigned char *memory;     // First granule
+    size_t granuleSize;
+    uint32_t granuleCount;
+    uint32_t headerGranules;   // Granules taken by an in-band header, 0 with a side table
+    ArenaBlock *sideTable;     // One header per granule, NULL with in-band headers
+    size_t sideTableBytes;
+    void *mapping;             // The arena, if it was mapped by createArena
+    size_t mappingBytes;
+    int placement;
+    uint32_t firstFreeBlock;   // First Fit: free list in address order
+    uint32_t bins[ARENA_BIN_COUNT];   // Best Fit: free list of every size class
+    uint64_t binBitmap[ARENA_BITMAP_WORDS]; // Size classes with free blocks
+    size_t allocatedBytes;     // Usable bytes of the allocated blocks
+    size_t allocatedBlocks;
+    size_t freeBlocks;
+};
+
+inline void initializeArenaOptions(ArenaOptions &options){
+    options.placement = ARENA_FIRST_FIT;
+    options.headers = ARENA_IN_BAND_HEADERS;
+    options.alignment = 16;
+}
+
+inline ArenaBlock &arenaBlock(ArenaAllocator &arena, uint32_t block){
+    if(arena.sideTable != NULL)
+    return arena.sideTable[block];
+    
+    return *(ArenaBlock *)(arena.memory + (size_t)block * arena.granuleSize);
+}
+
+inline bool isFreeArenaBlock(ArenaAllocator &arena, uint32_t block){
+    return (arenaBlock(arena, block).size & ARENA_FREE_BLOCK) != 0;
+}
+
+// Size class of a free block of size granules
+inline int arenaBin(uint32_t size){
+    if(size < (uint32_t)ARENA_EXACT_BIN_COUNT)
+    return size;
+    
+    int level = 31 - __builtin_clz(size);
+    return ARENA_EXACT_BIN_COUNT + (level - 6) * (1 << ARENA_SUBBIN_BITS) + (int)((size >> (level - ARENA_SUBBIN_BITS)) & ((1 << ARENA_SUBBIN_BITS) - 1));
+}
+
+// First size class from bin on with free blocks, -1 if there is none
+inline int nextArenaBin(const ArenaAllocator &arena, int bin){
+    if(bin >= ARENA_BIN_COUNT)
+    return -1;
+    
+    int word = bin / 64;
+    uint64_t bits = arena.binBitmap[word] & (~0ull << (bin % 64));
+    
+    while(bits == 0){
+        if(++word == ARENA_BITMAP_WORDS)
+        return -1;
+        
+        bits = arena.binBitmap[word];
+    }
+    
+    return word * 64 + __builtin_ctzll(bits);
+}
+
+// Adds a free block to its list: after predecessor (ARENA_NO_BLOCK -> first) in First Fit, at the front
+// of its size class in Best Fit
+inline void linkArenaFreeBlock(ArenaAllocator &arena, uint32_t block, uint32_t predecessor){
+    ArenaBlock &header = arenaBlock(arena, block);
+    uint32_t *head;
+    
+    if(arena.placement == ARENA_BEST_FIT){
+        int bin = arenaBin(header.size & ~ARENA_FREE_BLOCK);
+        head = &arena.bins[bin];
+        arena.binBitmap[bin / 64] |= 1ull << (bin % 64);
+        predecessor = ARENA_NO_BLOCK;
+    }
+    else
+    head = &arena.firstFreeBlock;
+    
+    uint32_t successor = predecessor == ARENA_NO_BLOCK ? *head : arenaBlock(arena, predecessor).nextFree;
+    
+    header.previousFree = predecessor;
+    header.nextFree = successor;
+    
+    if(predecessor == ARENA_NO_BLOCK)
+    *head = block;
+    else
+    arenaBlock(arena, predecessor).nextFree = block;
+    
+    if(successor != ARENA_NO_BLOCK)
+    arenaBlock(arena, successor).previousFree = block;
+}
+
+// Takes a free block out of its list, before its size changes
+inline void unlinkArenaFreeBlock(ArenaAllocator &arena, uint32_t block){
+    ArenaBlock &header = arenaBlock(arena, block);
+    
+    if(header.previousFree != ARENA_NO_BLOCK)
+    arenaBlock(arena, header.previousFree).nextFree = header.nextFree;
+    else if(arena.placement == ARENA_BEST_FIT){
+        int bin = arenaBin(header.size & ~ARENA_FREE_BLOCK);
+        arena.bins[bin] = header.nextFree;
+        
+        if(header.nextFree == ARENA_NO_BLOCK)
+        arena.binBitmap[bin / 64] &= ~(1ull << (bin % 64));
+    }
+    else
+    arena.firstFreeBlock = header.nextFree;
+    
+    if(header.nextFree != ARENA_NO_BLOCK)
+    arenaBlock(arena, header.nextFree).previousFree = header.previousFree;
+}
+
+// Free block with the lowest address of at least size granules, ARENA_NO_BLOCK if none is big enough
+inline uint32_t findFirstFitArenaBlock(ArenaAllocator &arena, uint32_t size){
+    for(uint32_t block = arena.firstFreeBlock; block != ARENA_NO_BLOCK; block = arenaBlock(arena, block).nextFree){
+        if((arenaBlock(arena, block).size & ~ARENA_FREE_BLOCK) >= size)
+        return block;
+    }
+    
+    return ARENA_NO_BLOCK;
+}
+
+// Smallest free block of at least size granules, ARENA_NO_BLOCK if none is big enough
+inline uint32_t findBestFitArenaBlock(ArenaAllocator &arena, uint32_t size){
+    int bin = arenaBin(size);
+    
+    //The class of size also holds smaller blocks, unless it is an exact one; the next classes only bigger ones
+    for(int candidateBin = nextArenaBin(arena, bin); candidateBin != -1; candidateBin = nextArenaBin(arena, candidateBin + 1)){
+        uint32_t bestBlock = ARENA_NO_BLOCK;
+        uint32_t bestSize = 0;
+        
+        for(uint32_t block = arena.bins[candidateBin]; block != ARENA_NO_BLOCK; block = arenaBlock(arena, block).nextFree){
+            uint32_t blockSize = arenaBlock(arena, block).size & ~ARENA_FREE_BLOCK;
+            
+            if(blockSize >= size && (bestBlock == ARENA_NO_BLOCK || blockSize < bestSize)){
+                bestBlock = block;
+                bestSize = blockSize;
+                
+                if(blockSize == size || candidateBin < ARENA_EXACT_BIN_COUNT)
+                break;
+            }
+        }
+        
+        if(bestBlock != ARENA_NO_BLOCK)
+        return bestBlock;
+    }
+    
+    return ARENA_NO_BLOCK;
+}
+
+// Sets up an arena over size bytes at memory, which the caller keeps until destroyArena. The start is
+// rounded up to the alignment. Returns false if the options are not valid, the memory cannot hold a
+// single allocation or the side table cannot be mapped.
+inline bool createArenaInMemory(ArenaAllocator &arena, void *memory, size_t size, const ArenaOptions &options){
+    size_t alignment = options.alignment;
+    
+    if(alignment < 8 || alignment > 65536 || (alignment & (alignment - 1)) != 0)
+    return false;
+    
+    if(options.placement != ARENA_FIRST_FIT && options.placement != ARENA_BEST_FIT)
+    return false;
+    
+    if(options.headers != ARENA_IN_BAND_HEADERS && options.headers != ARENA_SIDE_TABLE_HEADERS)
+    return false;
+    
+    uintptr_t start = ((uintptr_t)memory + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    if(memory == NULL || start - (uintptr_t)memory >= size)
+    return false;
+    
+    size_t granuleCount = (size - (start - (uintptr_t)memory)) / alignment;
+    if(granuleCount > ARENA_MAXIMUM_GRANULES)
+    granuleCount = ARENA_MAXIMUM_GRANULES;
+    
+    arena.memory = (unsigned char *)start;
+    arena.granuleSize = alignment;
+    arena.granuleCount = (uint32_t)granuleCount;
+    arena.headerGranules = options.headers == ARENA_IN_BAND_HEADERS ? (uint32_t)((sizeof(ArenaBlock) + alignment - 1) / alignment) : 0;
+    arena.sideTable = NULL;
+    arena.sideTableBytes = 0;
+    arena.mapping = NULL;
+    arena.mappingBytes = 0;
+    arena.placement = options.placement;
+    arena.allocatedBytes = 0;
+    arena.allocatedBlocks = 0;
+    arena.freeBlocks = 0;
+    
+    if(granuleCount <= arena.headerGranules)
+    return false;
+    
+    //Pages of the side table are only touched when a block starts in them
+    if(options.headers == ARENA_SIDE_TABLE_HEADERS){
+        size_t sideTableBytes = granuleCount * sizeof(ArenaBlock);
+        void *sideTable = mmap(NULL, sideTableBytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        
+        if(sideTable == MAP_FAILED)
+        return false;
+        
+        arena.sideTable = (ArenaBlock *)sideTable;
+        arena.sideTableBytes = sideTableBytes;
+    }
+    
+    arena.firstFreeBlock = ARENA_NO_BLOCK;
+    for(int bin = 0; bin < ARENA_BIN_COUNT; bin++)
+    arena.bins[bin] = ARENA_NO_BLOCK;
+    for(int word = 0; word < ARENA_BITMAP_WORDS; word++)
+    arena.binBitmap[word] = 0;
+    
+    //The whole arena starts as a single free block
+    ArenaBlock &header = arenaBlock(arena, 0);
+    header.size = arena.granuleCount | ARENA_FREE_BLOCK;
+    header.previousSize = 0;
+    linkArenaFreeBlock(arena, 0, ARENA_NO_BLOCK);
+    arena.freeBlocks = 1;
+    
+    return true;
+}
+
+// Sets up an arena over size bytes mapped with mmap, released by destroyArena
+inline bool createArena(ArenaAllocator &arena, size_t size, const ArenaOptions &options){
+    void *mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    
+    if(mapping == MAP_FAILED)
+    return false;
+    
+    if(!createArenaInMemory(arena, mapping, size, options)){
+        munmap(mapping, size);
+        return false;
+    }
+    
+    arena.mapping = mapping;
+    arena.mappingBytes = size;
+    return true;
+}
+
+// Releases what the arena mapped. Memory supplied by the caller is left to it.
+inline void destroyArena(ArenaAllocator &arena){
+    if(arena.sideTable != NULL)
+    munmap(arena.sideTable, arena.sideTableBytes);
+    
+    if(arena.mapping != NULL)
+    munmap(arena.mapping, arena.mappingBytes);
+    
+    arena.sideTable = NULL;
+    arena.mapping = NULL;
+    arena.granuleCount = 0;
+}
+
+// Returns size bytes aligned to the alignment of the arena, or NULL if no free block is big enough
+inline void *arenaAllocate(ArenaAllocator &arena, size_t size){
+    size_t payloadGranules = size == 0 ? 1 : (size - 1) / arena.granuleSize + 1;
+    
+    if(payloadGranules > arena.granuleCount - arena.headerGranules)
+    return NULL;
+    
+    uint32_t blockSize = (uint32_t)payloadGranules + arena.headerGranules;
+    uint32_t block = arena.placement == ARENA_BEST_FIT ? findBestFitArenaBlock(arena, blockSize) : findFirstFitArenaBlock(arena, blockSize);
+    
+    if(block == ARENA_NO_BLOCK)
+    return NULL;
+    
+    ArenaBlock &header = arenaBlock(arena, block);
+    uint32_t freeSize = header.size & ~ARENA_FREE_BLOCK;
+    uint32_t predecessor = header.previousFree;
+    unlinkArenaFreeBlock(arena, block);
+    
+    //The allocation takes the start of the block, and the rest stays free if it can hold an allocation
+    if(freeSize - blockSize > arena.headerGranules){
+        uint32_t rest = block + blockSize;
+        uint32_t restSize = freeSize - blockSize;
+        ArenaBlock &restHeader = arenaBlock(arena, rest);
+        
+        restHeader.size = restSize | ARENA_FREE_BLOCK;
+        restHeader.previousSize = blockSize;
+        if(rest + restSize < arena.granuleCount)
+        arenaBlock(arena, rest + restSize).previousSize = restSize;
+        
+        linkArenaFreeBlock(arena, rest, predecessor);
+    }
+    else{
+        blockSize = freeSize;
+        arena.freeBlocks--;
+    }
+    
+    header.size = blockSize;
+    arena.allocatedBytes += (size_t)(blockSize - arena.headerGranules) * arena.granuleSize;
+    arena.allocatedBlocks++;
+    
+    return arena.memory + (size_t)(block + arena.headerGranules) * arena.granuleSize;
+}
+
+// Gives back an allocation of the arena, merging it with the free blocks next to it. NULL is ignored.
+inline void arenaFree(ArenaAllocator &arena, void *pointer){
+    if(pointer == NULL)
+    return;
+    
+    uint32_t block = (uint32_t)(((unsigned char *)pointer - arena.memory) / arena.granuleSize) - arena.headerGranules;
+    uint32_t size = arenaBlock(arena, block).size;
+    uint32_t predecessor = ARENA_NO_BLOCK; // First Fit: free block right before it in address order
+    bool hasPredecessor = false;
+    
+    arena.allocatedBytes -= (size_t)(size - arena.headerGranules) * arena.granuleSize;
+    arena.allocatedBlocks--;
+    
+    //Merge with the next block
+    uint32_t next = block + size;
+    if(next < arena.granuleCount && isFreeArenaBlock(arena, next)){
+        predecessor = arenaBlock(arena, next).previousFree;
+        hasPredecessor = true;
+        unlinkArenaFreeBlock(arena, next);
+        size += arenaBlock(arena, next).size & ~ARENA_FREE_BLOCK;
+        arena.freeBlocks--;
+    }
+    
+    //Merge with the previous block, which takes the place of both in address order
+    uint32_t previousSize = arenaBlock(arena, block).previousSize;
+    if(previousSize != 0 && isFreeArenaBlock(arena, block - previousSize)){
+        block -= previousSize;
+        predecessor = arenaBlock(arena, block).previousFree;
+        hasPredecessor = true;
+        unlinkArenaFreeBlock(arena, block);
+        size += previousSize;
+        arena.freeBlocks--;
+    }
+    
+    //First Fit: a block between allocated ones looks for its place in the list
+    if(arena.placement == ARENA_FIRST_FIT && !hasPredecessor){
+        for(uint32_t freeBlock = arena.firstFreeBlock; freeBlock != ARENA_NO_BLOCK && freeBlock < block; freeBlock = arenaBlock(arena, freeBlock).nextFree)
+        predecessor = freeBlock;
+    }
+    
+    arenaBlock(arena, block).size = size | ARENA_FREE_BLOCK;
+    if(block + size < arena.granuleCount)
+    arenaBlock(arena, block + size).previousSize = size;
+    
+    linkArenaFreeBlock(arena, block, predecessor);
+    arena.freeBlocks++;
+}
+
+#endif
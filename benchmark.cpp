@@ -0,0 +1,354 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+using namespace std;
+
+// Scaling benchmark: generates seeded traces of increasing size with the --generate mode of the
+// simulator and runs every placement algorithm on each of them as a separate process, so that its
+// wall time and peak resident memory are its own. The results are written as a CSV or JSON table.
+
+struct BenchmarkOptions{
+    string simulatorFileName;
+    string resultsFileName;
+    vector<unsigned long long> processCounts;
+    vector<string> algorithms;
+    unsigned int totalMemory;
+    unsigned long long seed;
+    bool useJsonFormat;
+    vector<string> generatorOptions;  // Passed to --generate
+    vector<string> simulationOptions; // Passed to every simulation
+};
+
+struct BenchmarkResult{
+    unsigned long long processCount;
+    string algorithm;
+    double wallSeconds;
+    long long simulatedTimeUnits;
+    long long placements;
+    long peakResidentKilobytes;
+};
+
+void initializeBenchmarkOptions(BenchmarkOptions &benchmark){
+    benchmark.processCounts.clear();
+    for(unsigned long long processCount = 1000; processCount <= 10000000; processCount *= 10)
+    benchmark.processCounts.push_back(processCount);
+    
+    const char *const algorithms[] = {"f", "b", "n", "w", "buddy", "tlsf"};
+    benchmark.algorithms.assign(algorithms, algorithms + 6);
+    
+    //About a hundred processes alive at a time with the default generator ranges
+    benchmark.totalMemory = 65536;
+    benchmark.seed = 1;
+    benchmark.useJsonFormat = false;
+    benchmark.generatorOptions.clear();
+    benchmark.generatorOptions.push_back("--arrival-rate");
+    benchmark.generatorOptions.push_back("10");
+    benchmark.simulationOptions.clear();
+}
+
+void splitArgumentList(const char *argument, char separator, vector<string> &items){
+    items.clear();
+    string item;
+    
+    for(const char *character = argument; ; character++){
+        if(*character == separator || *character == '\0'){
+            if(!item.empty())
+            items.push_back(item);
+            item.clear();
+            
+            if(*character == '\0')
+            break;
+        }
+        else
+        item += *character;
+    }
+}
+
+double elapsedSeconds(chrono::steady_clock::time_point start){
+    return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+}
+
+// Runs arguments[0] with its standard output captured. Returns false if it could not be run or did not
+// exit normally.
+bool runChildProcess(const vector<string> &arguments, string &output, double &wallSeconds, long &peakResidentKilobytes){
+    int outputPipe[2];
+    
+    if(pipe(outputPipe) != 0)
+    return false;
+    
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    pid_t child = fork();
+    
+    if(child == -1){
+        close(outputPipe[0]);
+        close(outputPipe[1]);
+        return false;
+    }
+    
+    if(child == 0){
+        vector<char *> childArguments;
+        for(size_t i = 0; i < arguments.size(); i++)
+        childArguments.push_back(const_cast<char *>(arguments[i].c_str()));
+        childArguments.push_back(NULL);
+        
+        dup2(outputPipe[1], STDOUT_FILENO);
+        close(outputPipe[0]);
+        close(outputPipe[1]);
+        execv(childArguments[0], &childArguments[0]);
+        _exit(127);
+    }
+    
+    close(outputPipe[1]);
+    output.clear();
+    
+    char buffer[4096];
+    ssize_t readBytes;
+    while((readBytes = read(outputPipe[0], buffer, sizeof(buffer))) > 0)
+    output.append(buffer, readBytes);
+    close(outputPipe[0]);
+    
+    int status;
+    struct rusage usage;
+    if(wait4(child, &status, 0, &usage) != child)
+    return false;
+    
+    wallSeconds = elapsedSeconds(start);
+    peakResidentKilobytes = usage.ru_maxrss;
+    
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0;
+}
+
+// Value of the "<label>: <value>" line of the metrics report, -1 if it is missing
+long long reportedFigure(const string &output, const string &label){
+    size_t position = output.find("\n" + label + ": ");
+    
+    if(position == string::npos)
+    return -1;
+    
+    return atoll(output.c_str() + position + label.size() + 3);
+}
+
+string temporaryTraceFileName(unsigned long long processCount){
+    const char *directory = getenv("TMPDIR");
+    ostringstream fileName;
+    
+    fileName << (directory != NULL && directory[0] != '\0' ? directory : "/tmp") << "/memory_management_benchmark_" << getpid() << "_" << processCount << ".txt";
+    return fileName.str();
+}
+
+bool generateBenchmarkTrace(const BenchmarkOptions &benchmark, unsigned long long processCount, const string &traceFileName){
+    ostringstream count, seed;
+    count << processCount;
+    seed << benchmark.seed;
+    
+    vector<string> arguments;
+    arguments.push_back(benchmark.simulatorFileName);
+    arguments.push_back("--generate");
+    arguments.push_back(traceFileName);
+    arguments.push_back(count.str());
+    arguments.push_back("--seed");
+    arguments.push_back(seed.str());
+    arguments.insert(arguments.end(), benchmark.generatorOptions.begin(), benchmark.generatorOptions.end());
+    
+    string output;
+    double wallSeconds;
+    long peakResidentKilobytes;
+    
+    if(!runChildProcess(arguments, output, wallSeconds, peakResidentKilobytes) || output.find(" processes generated") == string::npos){
+        cout << "The trace of " << processCount << " processes could not be generated: " << output << endl;
+        return false;
+    }
+    
+    return true;
+}
+
+bool runBenchmarkSimulation(const BenchmarkOptions &benchmark, const string &traceFileName, const string &algorithm, BenchmarkResult &result){
+    ostringstream memory;
+    memory << benchmark.totalMemory;
+    
+    vector<string> arguments;
+    arguments.push_back(benchmark.simulatorFileName);
+    arguments.push_back(traceFileName);
+    arguments.push_back("/dev/null");
+    arguments.push_back(memory.str());
+    arguments.push_back("-" + algorithm);
+    
+    //No memory map dump: the benchmark measures the simulation, not the disk
+    arguments.push_back("--sample-every");
+    arguments.push_back("1000000000");
+    arguments.insert(arguments.end(), benchmark.simulationOptions.begin(), benchmark.simulationOptions.end());
+    
+    string output;
+    
+    if(!runChildProcess(arguments, output, result.wallSeconds, result.peakResidentKilobytes)
+    || output.find("Algorithm finished") == string::npos){
+        cout << "The simulation with -" << algorithm << " failed: " << output << endl;
+        return false;
+    }
+    
+    result.algorithm = algorithm;
+    result.simulatedTimeUnits = reportedFigure(output, "Total Simulation Time");
+    result.placements = reportedFigure(output, "Successful Allocations");
+    
+    return true;
+}
+
+void writeBenchmarkResults(const BenchmarkOptions &benchmark, const vector<BenchmarkResult> &results, ostream &table){
+    table.precision(12);
+    
+    if(benchmark.useJsonFormat)
+    table << "[" << endl;
+    else
+    table << "processes,algorithm,wall_seconds,simulated_time_units,time_units_per_second,placements,placements_per_second,peak_rss_kb" << endl;
+    
+    for(size_t i = 0; i < results.size(); i++){
+        const BenchmarkResult &result = results[i];
+        double timeUnitsPerSecond = result.wallSeconds > 0 ? result.simulatedTimeUnits / result.wallSeconds : 0;
+        double placementsPerSecond = result.wallSeconds > 0 ? result.placements / result.wallSeconds : 0;
+        
+        if(benchmark.useJsonFormat){
+            table << "  {\"processes\": " << result.processCount << ", \"algorithm\": \"" << result.algorithm
+            << "\", \"wall_seconds\": " << result.wallSeconds << ", \"simulated_time_units\": " << result.simulatedTimeUnits
+            << ", \"time_units_per_second\": " << timeUnitsPerSecond << ", \"placements\": " << result.placements
+            << ", \"placements_per_second\": " << placementsPerSecond << ", \"peak_rss_kb\": " << result.peakResidentKilobytes << "}"
+            << (i + 1 < results.size() ? "," : "") << endl;
+        }
+        else{
+            table << result.processCount << "," << result.algorithm << "," << result.wallSeconds << "," << result.simulatedTimeUnits
+            << "," << timeUnitsPerSecond << "," << result.placements << "," << placementsPerSecond << "," << result.peakResidentKilobytes << endl;
+        }
+    }
+    
+    if(benchmark.useJsonFormat)
+    table << "]" << endl;
+}
+
+bool runBenchmark(const BenchmarkOptions &benchmark){
+    vector<BenchmarkResult> results;
+    
+    for(size_t i = 0; i < benchmark.processCounts.size(); i++){
+        string traceFileName = temporaryTraceFileName(benchmark.processCounts[i]);
+        
+        if(!generateBenchmarkTrace(benchmark, benchmark.processCounts[i], traceFileName)){
+            unlink(traceFileName.c_str());
+            return false;
+        }
+        
+        for(size_t j = 0; j < benchmark.algorithms.size(); j++){
+            BenchmarkResult result;
+            result.processCount = benchmark.processCounts[i];
+            
+            if(!runBenchmarkSimulation(benchmark, traceFileName, benchmark.algorithms[j], result)){
+                unlink(traceFileName.c_str());
+                return false;
+            }
+            
+            cout << result.processCount << " processes, -" << result.algorithm << ": " << result.wallSeconds << " s, "
+            << result.peakResidentKilobytes << " KB" << endl;
+            results.push_back(result);
+        }
+        
+        unlink(traceFileName.c_str());
+    }
+    
+    ofstream table(benchmark.resultsFileName.c_str());
+    
+    if(!table){
+        cout << "The results file could not be created" << endl;
+        return false;
+    }
+    
+    writeBenchmarkResults(benchmark, results, table);
+    cout << "Benchmark results written to " << benchmark.resultsFileName << endl;
+    return true;
+}
+
+// Returns -1 if the arguments are right, 1 for a wrong list and 2 for an unknown option
+int benchmarkArgumentValidation(int argc, char *argv[], BenchmarkOptions &benchmark){
+    vector<string> items;
+    
+    initializeBenchmarkOptions(benchmark);
+    benchmark.simulatorFileName = argv[1];
+    benchmark.resultsFileName = argv[2];
+    
+    for(int i = 3; i < argc; i++){
+        if(strcmp(argv[i], "--processes") == 0 && i + 1 < argc){
+            splitArgumentList(argv[++i], ',', items);
+            benchmark.processCounts.clear();
+            
+            for(size_t j = 0; j < items.size(); j++){
+                if(strtoull(items[j].c_str(), NULL, 10) == 0)
+                return 1;
+                
+                benchmark.processCounts.push_back(strtoull(items[j].c_str(), NULL, 10));
+            }
+            
+            if(benchmark.processCounts.empty())
+            return 1;
+        }
+        
+        else if(strcmp(argv[i], "--algorithms") == 0 && i + 1 < argc){
+            splitArgumentList(argv[++i], ',', benchmark.algorithms);
+            
+            if(benchmark.algorithms.empty())
+            return 1;
+        }
+        
+        else if(strcmp(argv[i], "--memory") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        benchmark.totalMemory = atoi(argv[++i]);
+        
+        else if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        benchmark.seed = strtoull(argv[++i], NULL, 10);
+        
+        else if(strcmp(argv[i], "--format") == 0 && i + 1 < argc && (strcmp(argv[i + 1], "csv") == 0 || strcmp(argv[i + 1], "json") == 0))
+        benchmark.useJsonFormat = strcmp(argv[++i], "json") == 0;
+        
+        //Space separated options, e.g. "--sizes lognormal --arrival-rate 5"
+        else if(strcmp(argv[i], "--generator-options") == 0 && i + 1 < argc)
+        splitArgumentList(argv[++i], ' ', benchmark.generatorOptions);
+        
+        else if(strcmp(argv[i], "--simulation-options") == 0 && i + 1 < argc)
+        splitArgumentList(argv[++i], ' ', benchmark.simulationOptions);
+        
+        else
+        return 2;
+    }
+    
+    return -1;
+}
+
+int main(int argc, char *argv[]){
+    BenchmarkOptions benchmark;
+    
+    if(argc < 3){
+        cout << "Usage: " << argv[0] << " <simulator> <results file> [--processes 1000,10000,...] [--algorithms f,b,...]"
+        << " [--memory <n>] [--seed <n>] [--format csv|json] [--generator-options \"...\"] [--simulation-options \"...\"]" << endl;
+        return 1;
+    }
+    
+    int error = benchmarkArgumentValidation(argc, argv, benchmark);
+    
+    if(error == 1){
+        cout << "The lists of process counts and algorithms must not be empty, and the counts must be positive." << endl;
+        return 1;
+    }
+    else if(error == 2){
+        cout << "An unknown benchmark option has been entered." << endl;
+        return 1;
+    }
+    
+    return runBenchmark(benchmark) ? 0 : 1;
+}
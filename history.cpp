@@ -0,0 +1,347 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "memory_history.h"
+
+using namespace std;
+
+// History decoder: rebuilds time instants of a binary memory map history (written by the simulator
+// with --output-format binary) and writes them in the text format of the memory map dump. A time
+// instant is rebuilt from the keyframe before it, found by binary search in the index, so it takes at
+// most one keyframe interval of records whatever the length of the history.
+
+struct HistorySegment{
+    uint64_t startAddress;  // Memory units, as in the text dump
+    uint64_t size;
+    uint32_t kind;          // HISTORY_ASSIGN for a process, the reason of the hole otherwise
+    string name;            // Only for processes
+};
+
+struct HistoryFile{
+    const unsigned char *data;
+    size_t size;
+    const unsigned char *recordsEnd; // The index starts there
+    HistoryHeader header;
+    HistoryFooter footer;
+};
+
+// Position in the records and the memory map after the last record read
+struct HistoryCursor{
+    const unsigned char *position;
+    unsigned long long time;
+    vector<HistorySegment> segments;
+    vector<HistorySegment> events, nextSegments; // Of the record being read
+    uint64_t eventCounts[HISTORY_EVENT_KIND_COUNT]; // Of the delta records read
+};
+
+bool openHistoryFile(const string &fileName, HistoryFile &history){
+    int descriptor = open(fileName.c_str(), O_RDONLY);
+    struct stat status;
+    
+    if(descriptor == -1 || fstat(descriptor, &status) == -1){
+        cout << "The history '" << fileName << "' could not be opened" << endl;
+        if(descriptor != -1)
+        close(descriptor);
+        return false;
+    }
+    
+    history.size = status.st_size;
+    history.data = NULL;
+    
+    if(history.size >= sizeof(HistoryHeader) + sizeof(HistoryFooter)){
+        void *data = mmap(NULL, history.size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if(data != MAP_FAILED)
+        history.data = (const unsigned char *)data;
+    }
+    close(descriptor);
+    
+    if(history.data != NULL){
+        memcpy(&history.header, history.data, sizeof(history.header));
+        memcpy(&history.footer, history.data + history.size - sizeof(history.footer), sizeof(history.footer));
+    }
+    
+    //The index must fill the space between the records and the footer
+    if(history.data == NULL || memcmp(history.header.magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) != 0
+    || memcmp(history.footer.magic, HISTORY_INDEX_MAGIC, sizeof(HISTORY_INDEX_MAGIC)) != 0
+    || history.footer.indexOffset < sizeof(HistoryHeader) || history.footer.indexOffset > history.size
+    || history.footer.keyframeCount != (history.size - sizeof(HistoryFooter) - history.footer.indexOffset) / sizeof(HistoryIndexEntry)
+    || (history.size - sizeof(HistoryFooter) - history.footer.indexOffset) % sizeof(HistoryIndexEntry) != 0){
+        cout << "'" << fileName << "' is not a memory map history, or it is truncated" << endl;
+        return false;
+    }
+    
+    history.recordsEnd = history.data + history.footer.indexOffset;
+    return true;
+}
+
+HistoryIndexEntry historyKeyframe(const HistoryFile &history, uint64_t keyframe){
+    HistoryIndexEntry entry;
+    memcpy(&entry, history.recordsEnd + keyframe * sizeof(HistoryIndexEntry), sizeof(entry));
+    return entry;
+}
+
+// Last keyframe at or before time, or the first one if there is none
+uint64_t findHistoryKeyframe(const HistoryFile &history, unsigned long long time){
+    uint64_t first = 0, last = history.footer.keyframeCount;
+    
+    while(last - first > 1){
+        uint64_t middle = first + (last - first) / 2;
+        
+        if(historyKeyframe(history, middle).time <= time)
+        first = middle;
+        else
+        last = middle;
+    }
+    
+    return first;
+}
+
+void initializeHistoryCursor(const HistoryFile &history, uint64_t keyframe, HistoryCursor &cursor){
+    cursor.position = history.footer.keyframeCount == 0 ? history.recordsEnd : history.data + historyKeyframe(history, keyframe).offset;
+    cursor.time = 0;
+    cursor.segments.clear();
+    memset(cursor.eventCounts, 0, sizeof(cursor.eventCounts));
+}
+
+bool hasHistoryRecord(const HistoryFile &history, const HistoryCursor &cursor){
+    return cursor.position < history.recordsEnd;
+}
+
+// Time of the next record, without reading it
+bool peekHistoryRecordTime(const HistoryFile &history, const HistoryCursor &cursor, unsigned long long &time){
+    const unsigned char *position = cursor.position + 1;
+    uint64_t value;
+    
+    if(!decodeHistoryVarint(position, history.recordsEnd, value))
+    return false;
+    
+    time = *cursor.position == HISTORY_KEYFRAME ? value : cursor.time + value;
+    return true;
+}
+
+// The events of a record replace the segments they overlap; together they cover all of them
+void applyHistoryEvents(HistoryCursor &cursor){
+    vector<HistorySegment> &segments = cursor.segments;
+    vector<HistorySegment> &nextSegments = cursor.nextSegments;
+    uint64_t coveredEnd = 0;
+    size_t position = 0;
+    
+    nextSegments.clear();
+    for(size_t i = 0; i < cursor.events.size(); i++){
+        const HistorySegment &event = cursor.events[i];
+        
+        for(; position < segments.size() && segments[position].startAddress < event.startAddress; position++){
+            if(segments[position].startAddress >= coveredEnd && segments[position].startAddress + segments[position].size <= event.startAddress)
+            nextSegments.push_back(segments[position]);
+        }
+        
+        nextSegments.push_back(event);
+        coveredEnd = (uint64_t)event.startAddress + event.size;
+    }
+    
+    for(; position < segments.size(); position++){
+        if(segments[position].startAddress >= coveredEnd)
+        nextSegments.push_back(segments[position]);
+    }
+    
+    segments.swap(nextSegments);
+}
+
+// Reads the next record into the memory map of the cursor. False if the history is corrupted.
+bool readHistoryRecord(const HistoryFile &history, HistoryCursor &cursor){
+    const unsigned char *position = cursor.position + 1;
+    const unsigned char *end = history.recordsEnd;
+    bool isKeyframe = *cursor.position == HISTORY_KEYFRAME;
+    uint64_t time, eventCount, eventsEnd = 0;
+    
+    //Every event takes two bytes at least
+    if((!isKeyframe && *cursor.position != HISTORY_DELTA) || !decodeHistoryVarint(position, end, time) || !decodeHistoryVarint(position, end, eventCount)
+    || eventCount > (uint64_t)(end - position) / 2)
+    return false;
+    
+    cursor.events.resize(eventCount);
+    for(uint64_t i = 0; i < eventCount; i++){
+        HistorySegment &event = cursor.events[i];
+        uint64_t kindAndGap, size, nameLength = 0;
+        
+        if(!decodeHistoryVarint(position, end, kindAndGap) || !decodeHistoryVarint(position, end, size))
+        return false;
+        
+        event.kind = kindAndGap & ((1 << HISTORY_EVENT_KIND_BITS) - 1);
+        event.startAddress = eventsEnd + (kindAndGap >> HISTORY_EVENT_KIND_BITS);
+        event.size = size;
+        event.name.clear();
+        
+        if(event.kind == HISTORY_ASSIGN){
+            if(!decodeHistoryVarint(position, end, nameLength) || nameLength > (uint64_t)(end - position))
+            return false;
+            
+            event.name.assign((const char *)position, nameLength);
+            position += nameLength;
+        }
+        
+        eventsEnd = (uint64_t)event.startAddress + event.size;
+        if(!isKeyframe)
+        cursor.eventCounts[event.kind]++;
+    }
+    
+    if(isKeyframe){
+        cursor.segments.swap(cursor.events);
+        cursor.time = time;
+    }
+    else{
+        applyHistoryEvents(cursor);
+        cursor.time += time;
+    }
+    
+    cursor.position = position;
+    return true;
+}
+
+// "time [start name size] [start name size] ...", as in the text memory map dump
+void writeHistoryTimeInstant(ostream &output, const HistoryCursor &cursor, string &line){
+    line = to_string(cursor.time);
+    line += ' ';
+    
+    for(size_t i = 0; i < cursor.segments.size(); i++){
+        const HistorySegment &segment = cursor.segments[i];
+        
+        line += '[';
+        line += to_string(segment.startAddress);
+        line += ' ';
+        line += segment.kind == HISTORY_ASSIGN ? segment.name : string("hole");
+        line += ' ';
+        line += to_string(segment.size);
+        line += "] ";
+    }
+    
+    line += '\n';
+    output.write(line.data(), line.size());
+}
+
+bool reportCorruptedHistory(){
+    cout << "The history is corrupted" << endl;
+    return false;
+}
+
+// Writes the time instants from firstTime to lastTime (both included) that are in the history
+bool exportHistory(const HistoryFile &history, unsigned long long firstTime, unsigned long long lastTime, ostream &output){
+    HistoryCursor cursor;
+    string line;
+    initializeHistoryCursor(history, findHistoryKeyframe(history, firstTime), cursor);
+    
+    while(hasHistoryRecord(history, cursor)){
+        if(!readHistoryRecord(history, cursor))
+        return reportCorruptedHistory();
+        
+        if(cursor.time > lastTime)
+        break;
+        
+        if(cursor.time >= firstTime)
+        writeHistoryTimeInstant(output, cursor, line);
+    }
+    
+    return true;
+}
+
+// Writes the time instant, rebuilt from the keyframe before it
+bool showHistoryTimeInstant(const HistoryFile &history, unsigned long long time){
+    HistoryCursor cursor;
+    unsigned long long nextTime;
+    string line;
+    initializeHistoryCursor(history, findHistoryKeyframe(history, time), cursor);
+    
+    while(hasHistoryRecord(history, cursor)){
+        if(!peekHistoryRecordTime(history, cursor, nextTime))
+        return reportCorruptedHistory();
+        
+        if(nextTime > time)
+        break;
+        
+        if(!readHistoryRecord(history, cursor))
+        return reportCorruptedHistory();
+        
+        if(cursor.time == time){
+            writeHistoryTimeInstant(cout, cursor, line);
+            return true;
+        }
+    }
+    
+    cout << "The time instant " << time << " is not in the history" << endl;
+    return false;
+}
+
+bool printHistoryInfo(const HistoryFile &history){
+    HistoryCursor cursor;
+    unsigned long long firstTime = 0;
+    initializeHistoryCursor(history, 0, cursor);
+    
+    for(uint64_t record = 0; hasHistoryRecord(history, cursor); record++){
+        if(!readHistoryRecord(history, cursor))
+        return reportCorruptedHistory();
+        
+        if(record == 0)
+        firstTime = cursor.time;
+    }
+    
+    cout << "Time Instants: " << history.footer.recordCount;
+    if(history.footer.recordCount > 0)
+    cout << " (" << firstTime << " to " << cursor.time << ")";
+    cout << endl;
+    
+    cout << "Keyframes: " << history.footer.keyframeCount << " (one every " << history.header.keyframeEvery << " time instants)" << endl;
+    cout << "Size: " << history.size << " bytes" << endl;
+    cout << "Processes Assigned: " << cursor.eventCounts[HISTORY_ASSIGN] << endl;
+    cout << "Holes Freed / Merged / Split: " << cursor.eventCounts[HISTORY_FREE] << " / " << cursor.eventCounts[HISTORY_MERGE] << " / " << cursor.eventCounts[HISTORY_SPLIT] << endl;
+    
+    return true;
+}
+
+int main(int argc, char *argv[]){
+    HistoryFile history;
+    
+    if(argc < 3 || argc > 5){
+        cout << "Usage: " << argv[0] << " <history> <time>" << endl
+        << "       " << argv[0] << " <history> <first time> <last time> [<output file>]" << endl
+        << "       " << argv[0] << " <history> --info" << endl;
+        return 1;
+    }
+    
+    if(!openHistoryFile(argv[1], history))
+    return 1;
+    
+    if(strcmp(argv[2], "--info") == 0)
+    return printHistoryInfo(history) ? 0 : 1;
+    
+    if(argc == 3)
+    return showHistoryTimeInstant(history, strtoull(argv[2], NULL, 10)) ? 0 : 1;
+    
+    if(argc == 4)
+    return exportHistory(history, strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10), cout) ? 0 : 1;
+    
+    ofstream output(argv[4], ios::binary);
+    if(!output){
+        cout << "The output file could not be opened" << endl;
+        return 1;
+    }
+    
+    bool exported = exportHistory(history, strtoull(argv[2], NULL, 10), strtoull(argv[3], NULL, 10), output);
+    output.close();
+    
+    if(exported && !output){
+        cout << "The output file could not be completely written" << endl;
+        return 1;
+    }
+    
+    return exported ? 0 : 1;
+}
@@ -1,45 +1,447 @@
 #include<iostream>
 #include <vector>
+#include <map>
+#include <set>
+#include <queue>
+#include <functional>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <deque>
+#include <random>
+#include <unordered_map>
+#include <algorithm>
 #include <stdlib.h>
+#include <math.h>
 #include <string>
 #include <string.h>
+#include <stdint.h>
+#include <limits.h>
 
 #include <fstream>
-#include <sstream>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <errno.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#endif
+
+#include "memory_history.h"
 
 using namespace std;
 
+// Self-profiling: time per simulation phase and counters of the placement work, compiled in with
+// -DPROFILING and printed with --profile. Without PROFILING the PROFILE_* macros expand to nothing.
+const int PROFILE_QUEUE_RETRIES = 0;
+const int PROFILE_ARRIVALS = 1;
+const int PROFILE_OUTPUT = 2;
+const int PROFILE_METRICS = 3;
+const int PROFILE_COMPLETIONS = 4; // Finished processes freed and merged with their neighbours
+const int PROFILE_IDLE_SKIPS = 5;
+const int PROFILE_PHASE_COUNT = 6;
+const char *const PROFILE_PHASE_NAMES[PROFILE_PHASE_COUNT] = {"Queue Retries", "Arrival Placement", "Memory Map Output", "Metrics Update", "Completions and Merges", "Idle Time Skips"};
+
+#ifdef PROFILING
+#include <chrono>
+
+struct SimulationProfile{
+    uint64_t phaseNanoseconds[PROFILE_PHASE_COUNT];
+    uint64_t placementSearches;   // Holes looked up for a process, successfully or not
+    uint64_t scannedSegments;     // Segments (or segment table positions) visited by those searches and by compaction
+    uint64_t holeSplits;
+    uint64_t holeMerges;
+    uint64_t queueRingGrowths;
+    uint64_t segmentTableGrowths;
+    uint64_t processTableGrowths;
+    uint64_t heapAllocations;
+};
+
+// Per thread, so that the simulations of a sweep do not share it. Plain data: no initialization at run time.
+thread_local SimulationProfile simulationProfile;
+
+inline uint64_t profileClock(){
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+#define PROFILE_COUNT(counter, amount) (simulationProfile.counter += (amount))
+#define PROFILE_PHASE_BEGIN(phase) uint64_t phase##_START = profileClock()
+#define PROFILE_PHASE_END(phase) (simulationProfile.phaseNanoseconds[phase] += profileClock() - phase##_START)
+
+void *operator new(size_t size){
+    PROFILE_COUNT(heapAllocations, 1);
+    void *memory = malloc(size == 0 ? 1 : size);
+    
+    if(memory == NULL)
+    throw bad_alloc();
+    
+    return memory;
+}
+
+void operator delete(void *memory) noexcept{
+    free(memory);
+}
+
+void operator delete(void *memory, size_t) noexcept{
+    free(memory);
+}
+#else
+#define PROFILE_COUNT(counter, amount) ((void)0)
+#define PROFILE_PHASE_BEGIN(phase) ((void)0)
+#define PROFILE_PHASE_END(phase) ((void)0)
+#endif
+
 struct Process{
     string name;
     unsigned int arrivalTime;
-    unsigned int memoryRequirement;
+    uint64_t memoryRequirement;  // Memory units, rounded up to whole granules when placed
     unsigned int executionTimeUnits;
     unsigned int remainingTimeUnits;
 };
 
+// Processes waiting in the queue or placed in memory, each one stored once and referred to by a 32-bit
+// handle everywhere else. The slot of a process that finishes (or is discarded) is reused by the next
+// one, keeping the capacity of its name, so the table only grows with the processes alive at once.
+struct ProcessTable{
+    vector <Process> processes;
+    vector <uint32_t> generations; // Times each handle has been taken, to tell apart its processes
+    vector <uint32_t> freeHandles;
+};
+
+// Allocator for the nodes of the ordered indexes, which are inserted and erased all the time: freed
+// nodes are kept for the next insertion instead of being returned, so a simulation does not allocate
+// once its indexes have reached their biggest size. Each thread keeps its own nodes.
+struct RecycledNodes{
+    void *firstNode;
+    
+    ~RecycledNodes(){
+        while(firstNode != NULL){
+            void *node = firstNode;
+            firstNode = *(void **)node;
+            ::operator delete(node);
+        }
+    }
+};
+
+template <size_t NodeSize>
+RecycledNodes &recycledNodes(){
+    static thread_local RecycledNodes nodes = {NULL};
+    return nodes;
+}
+
+template <class T>
+struct RecyclingAllocator{
+    typedef T value_type;
+    
+    RecyclingAllocator(){}
+    template <class U> RecyclingAllocator(const RecyclingAllocator<U> &){}
+    
+    T *allocate(size_t count){
+        RecycledNodes &nodes = recycledNodes<sizeof(T)>();
+        
+        if(count == 1 && nodes.firstNode != NULL){
+            void *node = nodes.firstNode;
+            nodes.firstNode = *(void **)node;
+            return (T *)node;
+        }
+        
+        return (T *)::operator new(count * sizeof(T));
+    }
+    
+    void deallocate(T *pointer, size_t count){
+        if(count != 1 || sizeof(T) < sizeof(void *)){
+            ::operator delete(pointer);
+            return;
+        }
+        
+        RecycledNodes &nodes = recycledNodes<sizeof(T)>();
+        *(void **)pointer = nodes.firstNode;
+        nodes.firstNode = pointer;
+    }
+};
+
+template <class T, class U>
+bool operator==(const RecyclingAllocator<T> &, const RecyclingAllocator<U> &){
+    return true;
+}
+
+template <class T, class U>
+bool operator!=(const RecyclingAllocator<T> &, const RecyclingAllocator<U> &){
+    return false;
+}
+
+const int NO_SEGMENT = -1;
+
+// Segment states
+const uint32_t HOLE_SEGMENT = 0;
+const uint32_t PROCESS_SEGMENT = 1;
+const uint32_t UNUSED_SEGMENT = 2; // Position of the table not linked in the memory map
+
+// Memory map segments stored as a structure of arrays, so scans only touch the fields they need.
+// Segments are linked in address order through previousSegment / nextSegment. Addresses and sizes are
+// 64-bit granule indices, so a memory may hold any number of granules.
+struct SegmentTable{
+    vector <uint64_t> startAddress;
+    vector <uint64_t> size;
+    vector <uint32_t> state;
+    vector <uint32_t> processId; // Handle of the process in CPU::processes
+    vector <uint64_t> finishTime; // Value of CPU::elapsedTimeUnits at which the process finishes
+    vector <uint64_t> requestedSize; // Memory asked by the process in whole granules, less than size when the placement rounds it up
+    vector <int> previousSegment; // Neighbour at lower addresses, NO_SEGMENT for the first segment
+    vector <int> nextSegment;     // Neighbour at higher addresses, NO_SEGMENT for the last segment
+};
+
+// Buddy system: free blocks of 2^order units, aligned to their size, in one list per order
+const int BUDDY_ORDER_COUNT = 64;
+
+struct BuddyAllocator{
+    unsigned int minimumOrder;    // Smallest block: 2^minimumOrder
+    uint64_t nonEmptyOrders;      // Bit k set when there are free blocks of order k
+    int firstFreeBlock[BUDDY_ORDER_COUNT];
+    vector <int> previousFreeBlock; // Free list links, indexed by segment
+    vector <int> nextFreeBlock;
+};
+
+// TLSF: holes in segregated lists by size class, found through a bitmap of first levels (powers of two)
+// and, for each one, a bitmap of its TLSF_SECOND_LEVEL_COUNT linear subdivisions
+const int TLSF_SECOND_LEVEL_LOG2 = 4;
+const int TLSF_SECOND_LEVEL_COUNT = 1 << TLSF_SECOND_LEVEL_LOG2;
+const int TLSF_FIRST_LEVEL_COUNT = 64 - TLSF_SECOND_LEVEL_LOG2 + 1;
+
+struct SegregatedFitIndex{
+    uint64_t firstLevelMap;       // Bit f set when some class of the first level f has holes
+    uint32_t secondLevelMaps[TLSF_FIRST_LEVEL_COUNT];
+    int firstFreeHole[TLSF_FIRST_LEVEL_COUNT][TLSF_SECOND_LEVEL_COUNT];
+    vector <int> previousFreeHole; // Class list links, indexed by segment
+    vector <int> nextFreeHole;
+};
+
+// First Fit: the holes in address order, in blocks of up to FIRST_FIT_BLOCK_CAPACITY holes that are also in
+// address order. A search scans the biggest hole of every block until one is big enough and then that
+// block until a hole is, so it stops at the first hole that fits instead of looking at the whole table.
+const int FIRST_FIT_BLOCK_CAPACITY = 128;
+
+struct FirstFitBlock{
+    uint32_t holeCount;
+    uint64_t startAddress[FIRST_FIT_BLOCK_CAPACITY];
+    uint64_t size[FIRST_FIT_BLOCK_CAPACITY];
+    int segment[FIRST_FIT_BLOCK_CAPACITY];
+};
+
+struct FirstFitIndex{
+    vector <FirstFitBlock> blocks;        // In any order, reused through unusedBlocks
+    vector <int> unusedBlocks;
+    vector <int> blockOrder;              // Blocks in address order
+    vector <uint64_t> blockFirstAddress;  // Start of the first hole of every block, in address order
+    vector <uint64_t> blockLargestSize;   // Biggest hole of every block, in address order
+};
+
+// Hole indexes
+const int HOLE_INDEX_BY_SIZE = 0;        // CPU::memoryHolesBySize
+const int HOLE_INDEX_SEGREGATED_FIT = 1; // CPU::segregatedFit
+const int HOLE_INDEX_NONE = 2;
+
+// Processes waiting for memory: a ring buffer in arrival order plus an index by memory requirement, so
+// the oldest one, the smallest one and the biggest one up to a size are found in logarithmic time.
+// Processes taken from the middle leave their slot empty, and the head skips the empty slots.
+const uint64_t NO_QUEUED_PROCESS = UINT64_MAX;
+
+typedef set <pair<uint64_t, uint64_t>, less<pair<uint64_t, uint64_t> >, RecyclingAllocator<pair<uint64_t, uint64_t> > > QueuedProcessesBySize;
+typedef map <pair<uint64_t, uint64_t>, int, less<pair<uint64_t, uint64_t> >, RecyclingAllocator<pair<const pair<uint64_t, uint64_t>, int> > > MemoryHolesBySize;
+
+struct ProcessQueue{
+    vector <uint32_t> slots;      // Ring buffer of process handles, its capacity is a power of two
+    vector <uint8_t> isWaiting;   // The slot holds a process that is still in the queue
+    uint64_t head;                // Sequence number of the oldest process in the queue
+    uint64_t tail;                // Sequence number of the next process to enter
+    size_t length;
+    long long arrivalTimeSum;     // Of the processes in the queue, for the waiting time metrics
+    QueuedProcessesBySize processesBySize; // (memory requirement, sequence number)
+};
+
 struct CPU{
-    vector <Process> queue;
-    vector <Process> runningProcesses;
-    unsigned int totalMemory;
+    ProcessQueue queue;
+    SegmentTable segments;
+    vector <int> unusedSegments; // Table positions left by merged holes, reused by new holes
+    int firstSegment;
+    uint64_t elapsedTimeUnits;   // Time units already executed by the processor
+    uint64_t stalledTimeUnits;   // Time units the processor still spends compacting memory instead of executing
+    priority_queue <pair<uint64_t, int>, vector<pair<uint64_t, int> >, greater<pair<uint64_t, int> > > completions; // (finish time, segment) of every running process
+    ProcessTable processes;      // Processes in the queue or in memory
+    MemoryHolesBySize memoryHolesBySize; // (size, start address) -> hole segment
+    int holeIndex; // Index kept up to date for the holes: memoryHolesBySize, segregatedFit or none
+    SegregatedFitIndex segregatedFit;
+    bool indexesHolesByAddress;  // firstFit is kept up to date too, whatever holeIndex is
+    FirstFitIndex firstFit;
+    int nextFitSegment; // Next Fit rover: segment where the next search starts
+    bool hasPlacedSinceQueueRetry; // A process was placed after the last retry of the queue
+    BuddyAllocator buddy;
+    uint64_t granularity;        // Memory units per granule: the memory map is kept in granules, every size and address below too
+    uint64_t totalMemory;
+    uint64_t maximumPlacementSize; // Biggest request that can ever be placed
+    uint64_t usedMemory;         // Memory of the process segments; the rest is in holes
+    uint64_t holeCount;          // Every hole enters and leaves the hole index, which keeps the count
+    uint64_t internalFragmentation; // Memory of the process segments that their processes did not ask for
+};
+
+// Distribution of a value over the simulated time steps in a fixed number of buckets (HDR-style): values
+// under HISTOGRAM_SUB_BUCKET_COUNT have a bucket each, and bigger ones are kept with their highest
+// HISTOGRAM_PRECISION_LOG2 bits, so the error of any percentile is under 2%
+const int HISTOGRAM_PRECISION_LOG2 = 6;
+const int HISTOGRAM_SUB_BUCKET_COUNT = 1 << HISTOGRAM_PRECISION_LOG2;
+const int HISTOGRAM_BUCKET_COUNT = 2 * HISTOGRAM_SUB_BUCKET_COUNT + (64 - HISTOGRAM_PRECISION_LOG2 - 1) * HISTOGRAM_SUB_BUCKET_COUNT;
+
+struct MetricHistogram{
+    uint64_t counts[HISTOGRAM_BUCKET_COUNT];
+    uint64_t totalCount;
+    uint64_t maximum;
 };
 
 struct Metrics{
     int totalProcesses;
     int successfulAllocations;
     int allocationFailures;
-    int totalSimulationTime;
-    int totalMemoryTimeUsed; // Sum of memory usage over time for average calculation
-    int peakMemoryUsage;
-    int totalWaitingTime;
+    long long totalSimulationTime;
+    long long totalMemoryTimeUsed; // Sum of memory usage over time for average calculation
+    long long peakMemoryUsage;
+    long long totalWaitingTime;
     int processesCompleted;
     int minQueueLength;
     int maxQueueLength;
-    vector<int> memoryUtilizationOverTime;
-    vector<int> holeCountOverTime;
-    vector<int> holeSizesAtEnd;
-    vector<int> fragmentationOverTime; // Total size of holes at each time step
+    MetricHistogram memoryUsageHistogram;
+    MetricHistogram holeCountHistogram;
+    MetricHistogram fragmentationHistogram; // Total size of holes at each time step
+    int finalHoleCount;
+    long long finalHoleMemory;
+    uint64_t smallestFinalHole;
+    uint64_t largestFinalHole;
+    long long totalFragmentationTime; // Sum of hole sizes over every simulated time step
+    long long peakFragmentation;
+    long long simulatedTimeSteps; // Time steps accounted in the fragmentation average
+    bool reportsInternalFragmentation; // The placement rounds memory requirements up (e.g. buddy blocks)
+    long long roundedUpMemory; // Memory added by rounding up, over every allocation
+    long long requestedMemory; // Memory units asked for by the placed processes
+    long long granularityWaste; // Memory units added by rounding the placed processes up to whole granules
+    long long totalInternalFragmentationTime; // Sum of the rounded up memory of the resident processes over every time step
+    long long peakInternalFragmentation;
+    bool reportsCompaction; // Memory is compacted when the queued process picked next does not fit in any hole
+    int compactions;
+    long long compactedMemory; // Memory moved by the compactions
+    long long compactionTimeUnits; // Time units the processor spent compacting
+};
+
+// Placement algorithms, selected with -f, -b, -n, -w, -buddy and -tlsf
+const int FIRST_FIT_ALGORITHM = 0;
+const int BEST_FIT_ALGORITHM = 1;
+const int NEXT_FIT_ALGORITHM = 2;
+const int WORST_FIT_ALGORITHM = 3;
+const int BUDDY_ALGORITHM = 4;
+const int TLSF_ALGORITHM = 5;
+const int ALGORITHM_COUNT = 6;
+const char *const ALGORITHM_COMMANDS[ALGORITHM_COUNT] = {"f", "b", "n", "w", "buddy", "tlsf"};
+const char *const ALGORITHM_NAMES[ALGORITHM_COUNT] = {"FIRST FIT", "BEST FIT", "NEXT FIT", "WORST FIT", "BUDDY SYSTEM", "TLSF"};
+const char *const ALGORITHM_DESCRIPTIONS[ALGORITHM_COUNT] = {"first fit", "best fit", "next fit", "worst fit", "buddy system", "tlsf"};
+
+// Compaction modes
+const int NO_COMPACTION = 0;
+const int FULL_COMPACTION = 1;    // Every process slides toward address 0
+const int PARTIAL_COMPACTION = 2; // Only the processes of the cheapest run of segments that frees enough memory
+
+// Queue policies: which processes of the queue are tried, and in which order, every time unit
+const int FIFO_QUEUE = 0;           // Only the oldest one, the rest wait behind it
+const int BACKFILL_QUEUE = 1;       // The oldest one and, while it does not fit, the biggest ones that fit in the biggest hole
+const int SMALLEST_FIRST_QUEUE = 2; // The smallest one
+const int AGING_QUEUE = 3;          // The smallest one, unless the oldest one has waited too long
+const int QUEUE_POLICY_COUNT = 4;
+const char *const QUEUE_POLICY_COMMANDS[QUEUE_POLICY_COUNT] = {"fifo", "backfill", "smallest", "aging"};
+
+// Multi-bank routers: the bank that every arrival goes to
+const int ROUND_ROBIN_ROUTER = 0;  // Each bank in turn
+const int LEAST_LOADED_ROUTER = 1; // The bank with the smallest share of its memory in use
+const int BEST_FIT_ROUTER = 2;     // The bank whose biggest hole is the tightest fit, or else the least loaded one
+const int BANK_ROUTER_COUNT = 3;
+const char *const BANK_ROUTER_COMMANDS[BANK_ROUTER_COUNT] = {"round-robin", "least-loaded", "best-fit"};
+
+struct SimulationOptions{
+    bool eventDriven; // Jump straight to the next arrival or completion instead of simulating idle time units
+    size_t arrivalChunkSize; // Arrivals read from the trace at a time
+    size_t sortMemoryBudget; // Processes sorted in memory at most; bigger unsorted traces are sorted on disk
+    size_t outputBufferSize; // Bytes of memory map dump kept in memory before writing them
+    unsigned int outputSampleEvery; // Dump one of every N time instants
+    bool outputDeltaOnly;    // Dump only the segments that changed
+    bool outputBinaryHistory; // Dump a binary history (see memory_history.h) instead of the text memory map
+    unsigned int historyKeyframeEvery; // Time instants between keyframes of the binary history
+    bool asyncOutput;        // Format and write the dump in a separate thread
+    size_t asyncRingEntries; // Capacity of the ring that feeds the writer thread
+    bool asyncDropWhenFull;  // Drop time instants instead of waiting when the ring is full
+    unsigned int buddyMinimumBlockSize; // Smallest buddy block, a power of two
+    int compaction;          // NO_COMPACTION, FULL_COMPACTION or PARTIAL_COMPACTION
+    double compactionCost;   // Time units the processor spends per memory unit moved
+    bool profile;            // Print where the simulation spent its time (needs a build with -DPROFILING)
+    int queuePolicy;         // FIFO_QUEUE, BACKFILL_QUEUE, SMALLEST_FIRST_QUEUE or AGING_QUEUE
+    unsigned int queueAgingLimit; // Waiting time after which the aging policy serves the oldest process first
+    unsigned int checkpointInterval; // Time units between checkpoints, 0 -> none
+    string checkpointPrefix;  // Checkpoints are written to <prefix>-<time unit>.ckpt
+    string restoreFileName;   // Checkpoint the simulation resumes from, empty -> start from time unit 1
+    unsigned int bankCount;   // Independent memory banks the memory is split into, each one simulated on its own thread
+    int bankRouter;           // ROUND_ROBIN_ROUTER, LEAST_LOADED_ROUTER or BEST_FIT_ROUTER
+    bool streamArrivals;      // Read the arrivals from a pipe while simulating, instead of from a trace
+    unsigned int streamMetricsEvery; // Arrivals between rolling metrics lines in streaming mode
+    uint64_t granularity;     // Memory units per granule: processes are rounded up to whole granules, so holes stay aligned to them
 };
 
+void initializeMetricHistogram(MetricHistogram &histogram) {
+    memset(histogram.counts, 0, sizeof(histogram.counts));
+    histogram.totalCount = 0;
+    histogram.maximum = 0;
+}
+
+int metricHistogramBucket(uint64_t value) {
+    if(value < (uint64_t)(2 * HISTOGRAM_SUB_BUCKET_COUNT))
+    return value;
+    
+    int shift = 63 - __builtin_clzll(value) - HISTOGRAM_PRECISION_LOG2;
+    return shift * HISTOGRAM_SUB_BUCKET_COUNT + (value >> shift);
+}
+
+// Biggest value that falls in the bucket
+uint64_t metricHistogramBucketLimit(int bucket) {
+    if(bucket < 2 * HISTOGRAM_SUB_BUCKET_COUNT)
+    return bucket;
+    
+    int shift = bucket / HISTOGRAM_SUB_BUCKET_COUNT - 1;
+    uint64_t firstValue = (uint64_t)(bucket - shift * HISTOGRAM_SUB_BUCKET_COUNT) << shift;
+    return firstValue + ((1ull << shift) - 1);
+}
+
+// Records value count times (e.g. once per time step it lasted)
+void recordMetricHistogramValue(MetricHistogram &histogram, uint64_t value, uint64_t count) {
+    histogram.counts[metricHistogramBucket(value)] += count;
+    histogram.totalCount += count;
+    histogram.maximum = max(histogram.maximum, value);
+}
+
+// Smallest recorded value that is not exceeded by percentile% of the records, up to the bucket precision
+uint64_t metricHistogramPercentile(const MetricHistogram &histogram, double percentile) {
+    uint64_t targetCount = (uint64_t)ceil(histogram.totalCount * percentile / 100);
+    uint64_t countedRecords = 0;
+    
+    if(targetCount == 0)
+    targetCount = 1;
+    
+    for(int bucket = 0; bucket < HISTOGRAM_BUCKET_COUNT; bucket++) {
+        countedRecords += histogram.counts[bucket];
+        if(countedRecords >= targetCount)
+        return min(metricHistogramBucketLimit(bucket), histogram.maximum);
+    }
+    
+    return histogram.maximum;
+}
+
 void initializeMetrics(Metrics &metrics) {
     metrics.totalProcesses = 0;
     metrics.successfulAllocations = 0;
@@ -51,26 +453,63 @@ void initializeMetrics(Metrics &metrics) {
     metrics.processesCompleted = 0;
     metrics.minQueueLength = 999999; // Initialize to a large number
     metrics.maxQueueLength = 0;
-    metrics.memoryUtilizationOverTime.clear();
-    metrics.holeCountOverTime.clear();
-    metrics.holeSizesAtEnd.clear();
-    metrics.fragmentationOverTime.clear();
+    initializeMetricHistogram(metrics.memoryUsageHistogram);
+    initializeMetricHistogram(metrics.holeCountHistogram);
+    initializeMetricHistogram(metrics.fragmentationHistogram);
+    metrics.finalHoleCount = 0;
+    metrics.finalHoleMemory = 0;
+    metrics.smallestFinalHole = 0;
+    metrics.largestFinalHole = 0;
+    metrics.totalFragmentationTime = 0;
+    metrics.peakFragmentation = 0;
+    metrics.simulatedTimeSteps = 0;
+    metrics.reportsInternalFragmentation = false;
+    metrics.roundedUpMemory = 0;
+    metrics.requestedMemory = 0;
+    metrics.granularityWaste = 0;
+    metrics.totalInternalFragmentationTime = 0;
+    metrics.peakInternalFragmentation = 0;
+    metrics.reportsCompaction = false;
+    metrics.compactions = 0;
+    metrics.compactedMemory = 0;
+    metrics.compactionTimeUnits = 0;
 }
 
-void updateMetrics(Metrics &metrics, const CPU &processor, int currentTime, int totalMemory) {
-    // Calculate current memory usage
-    int currentMemoryUsage = 0;
-    int holeCount = 0;
-    int totalFragmentation = 0;
-    
-    for(int i = 0; i < (int)processor.runningProcesses.size(); i++) {
-        if(processor.runningProcesses[i].name.compare("hole") != 0) {
-            currentMemoryUsage += processor.runningProcesses[i].memoryRequirement;
-        } else {
-            holeCount++;
-            totalFragmentation += processor.runningProcesses[i].memoryRequirement;
-        }
-    }
+void initializeSimulationOptions(SimulationOptions &options) {
+    options.eventDriven = false;
+    options.arrivalChunkSize = 4096;
+    options.sortMemoryBudget = 1 << 22;
+    options.outputBufferSize = 1 << 20;
+    options.outputSampleEvery = 1;
+    options.outputDeltaOnly = false;
+    options.outputBinaryHistory = false;
+    options.historyKeyframeEvery = HISTORY_DEFAULT_KEYFRAME_EVERY;
+    options.asyncOutput = false;
+    options.asyncRingEntries = 1 << 16;
+    options.asyncDropWhenFull = false;
+    options.buddyMinimumBlockSize = 1;
+    options.compaction = NO_COMPACTION;
+    options.compactionCost = 0;
+    options.profile = false;
+    options.queuePolicy = FIFO_QUEUE;
+    options.queueAgingLimit = 100;
+    options.checkpointInterval = 0;
+    options.checkpointPrefix = "checkpoint";
+    options.restoreFileName = "";
+    options.bankCount = 1;
+    options.bankRouter = ROUND_ROBIN_ROUTER;
+    options.streamArrivals = false;
+    options.streamMetricsEvery = 100;
+    options.granularity = 1;
+}
+
+// Accounts for the current time step. The memory and hole figures are kept up to date by the processor
+// as segments are split, merged, placed and freed, so nothing is scanned.
+void updateMetrics(Metrics &metrics, const CPU &processor, long long currentTime, uint64_t totalMemory) {
+    long long currentMemoryUsage = processor.usedMemory;
+    uint64_t holeCount = processor.holeCount;
+    long long totalFragmentation = totalMemory - processor.usedMemory;
+    long long internalFragmentation = processor.internalFragmentation; // Memory inside the process segments that the processes did not ask for
     
     // Update peak memory usage
     if(currentMemoryUsage > metrics.peakMemoryUsage) {
@@ -78,7 +517,7 @@ void updateMetrics(Metrics &metrics, const CPU &processor, int currentTime, int
     }
     
     // Track queue length
-    int currentQueueLength = processor.queue.size();
+    int currentQueueLength = processor.queue.length;
     if(currentQueueLength < metrics.minQueueLength) {
         metrics.minQueueLength = currentQueueLength;
     }
@@ -86,28 +525,61 @@ void updateMetrics(Metrics &metrics, const CPU &processor, int currentTime, int
         metrics.maxQueueLength = currentQueueLength;
     }
     
-    // Store utilization and hole count for this time step
-    metrics.memoryUtilizationOverTime.push_back(currentMemoryUsage);
-    metrics.holeCountOverTime.push_back(holeCount);
-    metrics.fragmentationOverTime.push_back(totalFragmentation);
+    // Record utilization, hole count and fragmentation of this time step
+    recordMetricHistogramValue(metrics.memoryUsageHistogram, currentMemoryUsage, 1);
+    recordMetricHistogramValue(metrics.holeCountHistogram, holeCount, 1);
+    recordMetricHistogramValue(metrics.fragmentationHistogram, totalFragmentation, 1);
     metrics.totalMemoryTimeUsed += currentMemoryUsage;
-    
-    // Calculate waiting time for processes in queue
-    for(int i = 0; i < (int)processor.queue.size(); i++) {
-        metrics.totalWaitingTime += (currentTime - processor.queue[i].arrivalTime);
+    metrics.totalFragmentationTime += totalFragmentation;
+    metrics.simulatedTimeSteps++;
+    if(totalFragmentation > metrics.peakFragmentation) {
+        metrics.peakFragmentation = totalFragmentation;
+    }
+    metrics.totalInternalFragmentationTime += internalFragmentation;
+    if(internalFragmentation > metrics.peakInternalFragmentation) {
+        metrics.peakInternalFragmentation = internalFragmentation;
     }
+    
+    // Every queued process waits currentTime - arrival time units in this time step
+    metrics.totalWaitingTime += (long long)processor.queue.length * currentTime - processor.queue.arrivalTimeSum;
+}
+
+// Accounts for idleTimeUnits consecutive time steps, starting at firstIdleTime, in which neither
+// the memory map nor the queue change. Equivalent to calling updateMetrics once per time step.
+void updateMetricsForIdleTimeUnits(Metrics &metrics, const CPU &processor, long long firstIdleTime, long long idleTimeUnits) {
+    long long totalFragmentation = processor.totalMemory - processor.usedMemory;
+    
+    recordMetricHistogramValue(metrics.memoryUsageHistogram, processor.usedMemory, idleTimeUnits);
+    recordMetricHistogramValue(metrics.holeCountHistogram, processor.holeCount, idleTimeUnits);
+    recordMetricHistogramValue(metrics.fragmentationHistogram, totalFragmentation, idleTimeUnits);
+    metrics.totalMemoryTimeUsed += (long long)processor.usedMemory * idleTimeUnits;
+    metrics.totalFragmentationTime += totalFragmentation * idleTimeUnits;
+    metrics.totalInternalFragmentationTime += (long long)processor.internalFragmentation * idleTimeUnits;
+    metrics.simulatedTimeSteps += idleTimeUnits;
+    
+    // Every queued process waits (firstIdleTime - arrival) + 0 + 1 + ... + (idleTimeUnits - 1) time units
+    long long queuedProcesses = processor.queue.length;
+    long long waitingTime = queuedProcesses * (idleTimeUnits * (idleTimeUnits - 1) / 2);
+    waitingTime += (queuedProcesses * firstIdleTime - processor.queue.arrivalTimeSum) * idleTimeUnits;
+    metrics.totalWaitingTime += waitingTime;
 }
 
-void finalizeMetrics(Metrics &metrics, const CPU &processor, int totalMemory) {
-    // Collect final hole sizes
-    for(int i = 0; i < (int)processor.runningProcesses.size(); i++) {
-        if(processor.runningProcesses[i].name.compare("hole") == 0) {
-            metrics.holeSizesAtEnd.push_back(processor.runningProcesses[i].memoryRequirement);
+void finalizeMetrics(Metrics &metrics, const CPU &processor, uint64_t totalMemory) {
+    // Summarize final hole sizes
+    for(int segment = processor.firstSegment; segment != NO_SEGMENT; segment = processor.segments.nextSegment[segment]) {
+        if(processor.segments.state[segment] == HOLE_SEGMENT) {
+            uint64_t holeSize = processor.segments.size[segment];
+            
+            if(metrics.finalHoleCount == 0 || holeSize < metrics.smallestFinalHole) metrics.smallestFinalHole = holeSize;
+            if(metrics.finalHoleCount == 0 || holeSize > metrics.largestFinalHole) metrics.largestFinalHole = holeSize;
+            metrics.finalHoleCount++;
+            metrics.finalHoleMemory += holeSize;
         }
     }
 }
 
-void printMetrics(const Metrics &metrics, int totalMemory, const string &algorithmName) {
+// The memory figures are kept in granules, as totalMemory; they are printed in memory units
+void printMetrics(const Metrics &metrics, uint64_t totalMemory, uint64_t granularity, const string &algorithmName) {
     cout << "\n========== " << algorithmName << " ALGORITHM METRICS ==========" << endl;
     cout << "Total Processes: " << metrics.totalProcesses << endl;
     cout << "Successful Allocations: " << metrics.successfulAllocations << endl;
@@ -122,14 +594,14 @@ void printMetrics(const Metrics &metrics, int totalMemory, const string &algorit
     cout << "Total Simulation Time: " << metrics.totalSimulationTime << endl;
     
     if(metrics.totalSimulationTime > 0) {
-        double avgUtilization = (double)metrics.totalMemoryTimeUsed / (metrics.totalSimulationTime * totalMemory) * 100;
+        double avgUtilization = (double)metrics.totalMemoryTimeUsed / ((double)metrics.totalSimulationTime * totalMemory) * 100;
         cout << "Average Memory Utilization: " << avgUtilization << "%" << endl;
         
         double throughput = (double)metrics.processesCompleted / metrics.totalSimulationTime;
         cout << "Throughput (processes/time unit): " << throughput << endl;
     }
     
-    cout << "Peak Memory Usage: " << metrics.peakMemoryUsage << "/" << totalMemory 
+    cout << "Peak Memory Usage: " << metrics.peakMemoryUsage * granularity << "/" << totalMemory * granularity
          << " (" << (double)metrics.peakMemoryUsage / totalMemory * 100 << "%)" << endl;
     
     if(metrics.successfulAllocations > 0) {
@@ -142,487 +614,4570 @@ void printMetrics(const Metrics &metrics, int totalMemory, const string &algorit
     cout << "Maximum Queue Length: " << metrics.maxQueueLength << endl;
     
     // Calculate and display average fragmentation over time
-    if(!metrics.fragmentationOverTime.empty()) {
-        int totalFragmentation = 0;
-        int maxFragmentation = 0;
-        for(int i = 0; i < (int)metrics.fragmentationOverTime.size(); i++) {
-            totalFragmentation += metrics.fragmentationOverTime[i];
-            if(metrics.fragmentationOverTime[i] > maxFragmentation) {
-                maxFragmentation = metrics.fragmentationOverTime[i];
-            }
-        }
-        double avgFragmentation = (double)totalFragmentation / metrics.fragmentationOverTime.size();
-        cout << "Average Fragmentation (over time): " << avgFragmentation << " (" 
+    if(metrics.simulatedTimeSteps > 0) {
+        double avgFragmentation = (double)metrics.totalFragmentationTime / metrics.simulatedTimeSteps;
+        cout << "Average Fragmentation (over time): " << avgFragmentation * granularity << " (" 
              << (avgFragmentation / totalMemory * 100) << "% of total memory)" << endl;
-        cout << "Peak Fragmentation: " << maxFragmentation << " (" 
-             << ((double)maxFragmentation / totalMemory * 100) << "% of total memory)" << endl;
+        cout << "Peak Fragmentation: " << metrics.peakFragmentation * granularity << " (" 
+             << ((double)metrics.peakFragmentation / totalMemory * 100) << "% of total memory)" << endl;
     }
     
-    cout << "Final Number of Memory Holes: " << metrics.holeSizesAtEnd.size() << endl;
+    // Distributions over time
+    if(metrics.simulatedTimeSteps > 0) {
+        cout << "Memory Usage Percentiles (p50/p90/p99): " << metricHistogramPercentile(metrics.memoryUsageHistogram, 50) * granularity << " / "
+             << metricHistogramPercentile(metrics.memoryUsageHistogram, 90) * granularity << " / " << metricHistogramPercentile(metrics.memoryUsageHistogram, 99) * granularity << endl;
+        cout << "Hole Count Percentiles (p50/p90/p99): " << metricHistogramPercentile(metrics.holeCountHistogram, 50) << " / "
+             << metricHistogramPercentile(metrics.holeCountHistogram, 90) << " / " << metricHistogramPercentile(metrics.holeCountHistogram, 99) << endl;
+        cout << "Fragmentation Percentiles (p50/p90/p99): " << metricHistogramPercentile(metrics.fragmentationHistogram, 50) * granularity << " / "
+             << metricHistogramPercentile(metrics.fragmentationHistogram, 90) * granularity << " / " << metricHistogramPercentile(metrics.fragmentationHistogram, 99) * granularity << endl;
+    }
+    
+    // Granularity: memory added by rounding the processes up to whole granules
+    if(granularity > 1) {
+        cout << "Allocation Granularity: " << granularity << " (" << totalMemory << " granules)" << endl;
+        cout << "Memory Rounded Up to the Granularity: " << metrics.granularityWaste;
+        if(metrics.requestedMemory > 0)
+        cout << " (" << (double)metrics.granularityWaste / metrics.requestedMemory * 100 << "% of the memory requested)";
+        cout << endl;
+    }
     
-    if(!metrics.holeSizesAtEnd.empty()) {
-        int totalHoleSize = 0;
-        int minHole = metrics.holeSizesAtEnd[0];
-        int maxHole = metrics.holeSizesAtEnd[0];
+    // Internal fragmentation: memory given to processes beyond what they asked for
+    if(metrics.reportsInternalFragmentation) {
+        cout << "Memory Rounded Up on Allocation: " << metrics.roundedUpMemory * granularity << endl;
         
-        for(int i = 0; i < (int)metrics.holeSizesAtEnd.size(); i++) {
-            totalHoleSize += metrics.holeSizesAtEnd[i];
-            if(metrics.holeSizesAtEnd[i] < minHole) minHole = metrics.holeSizesAtEnd[i];
-            if(metrics.holeSizesAtEnd[i] > maxHole) maxHole = metrics.holeSizesAtEnd[i];
+        if(metrics.simulatedTimeSteps > 0) {
+            double avgInternalFragmentation = (double)metrics.totalInternalFragmentationTime / metrics.simulatedTimeSteps;
+            cout << "Average Internal Fragmentation (over time): " << avgInternalFragmentation * granularity << " ("
+                 << (avgInternalFragmentation / totalMemory * 100) << "% of total memory)" << endl;
+            cout << "Peak Internal Fragmentation: " << metrics.peakInternalFragmentation * granularity << " ("
+                 << ((double)metrics.peakInternalFragmentation / totalMemory * 100) << "% of total memory)" << endl;
         }
-        
-        double avgHoleSize = (double)totalHoleSize / metrics.holeSizesAtEnd.size();
-        cout << "Average Hole Size: " << avgHoleSize << endl;
-        cout << "Smallest Hole: " << minHole << endl;
-        cout << "Largest Hole: " << maxHole << endl;
-        cout << "Total Fragmented Memory: " << totalHoleSize << "/" << totalMemory 
-             << " (" << (double)totalHoleSize / totalMemory * 100 << "%)" << endl;
+    }
+    
+    // Compaction: how often it was needed and what it cost
+    if(metrics.reportsCompaction) {
+        cout << "Compactions: " << metrics.compactions << endl;
+        cout << "Memory Moved by Compaction: " << metrics.compactedMemory * granularity << endl;
+        cout << "Time Spent Compacting: " << metrics.compactionTimeUnits << " time units" << endl;
+    }
+    
+    cout << "Final Number of Memory Holes: " << metrics.finalHoleCount << endl;
+    
+    if(metrics.finalHoleCount > 0) {
+        double avgHoleSize = (double)metrics.finalHoleMemory / metrics.finalHoleCount;
+        cout << "Average Hole Size: " << avgHoleSize * granularity << endl;
+        cout << "Smallest Hole: " << metrics.smallestFinalHole * granularity << endl;
+        cout << "Largest Hole: " << metrics.largestFinalHole * granularity << endl;
+        cout << "Total Fragmented Memory: " << metrics.finalHoleMemory * granularity << "/" << totalMemory * granularity
+             << " (" << (double)metrics.finalHoleMemory / totalMemory * 100 << "%)" << endl;
     }
     
     cout << "=========================================================\n" << endl;
 }
 
-void loadProcessesFromFile(string importFileName, vector<Process> &processes){
-    ifstream inputFile;
+#ifdef PROFILING
+// Where the simulation spent its time, and how much placement work it did
+void printSimulationProfile(const Metrics &metrics, uint64_t simulationNanoseconds) {
+    const SimulationProfile &profile = simulationProfile;
+    double simulationSeconds = simulationNanoseconds / 1e9;
     
-    inputFile.open(importFileName.c_str(), ios::in);
+    cout << "========== PROFILE ==========" << endl;
+    cout << "Simulation Wall Time: " << simulationSeconds * 1000 << " ms" << endl;
     
-    if(inputFile.is_open()){
-        string currentFileLine="";
-        
-        //Leemos currentFileLine a currentFileLine
-        while(getline(inputFile, currentFileLine)){
-            stringstream ss(currentFileLine);
-            Process loadedProcess;
-            
-            ss >> loadedProcess.name >> loadedProcess.arrivalTime >> loadedProcess.memoryRequirement >> loadedProcess.executionTimeUnits;
-            loadedProcess.remainingTimeUnits = loadedProcess.executionTimeUnits;
-            
-            processes.push_back(loadedProcess);
-        }
-        
-        inputFile.close(); 
+    for(int phase = 0; phase < PROFILE_PHASE_COUNT; phase++) {
+        cout << PROFILE_PHASE_NAMES[phase] << ": " << profile.phaseNanoseconds[phase] / 1e6 << " ms";
+        if(simulationNanoseconds > 0)
+        cout << " (" << (double)profile.phaseNanoseconds[phase] / simulationNanoseconds * 100 << "%)";
+        cout << endl;
     }
-    else {
-        cout << "Error: The input file '" << importFileName << "' was not found in the current directory or could not be opened." << endl;
+    
+    if(simulationSeconds > 0) {
+        cout << "Simulated Time Units per Second: " << metrics.totalSimulationTime / simulationSeconds << endl;
+        cout << "Placements per Second: " << metrics.successfulAllocations / simulationSeconds << endl;
     }
+    
+    cout << "Placement Searches: " << profile.placementSearches << endl;
+    if(profile.placementSearches > 0)
+    cout << "Segments Scanned per Search: " << (double)profile.scannedSegments / profile.placementSearches << endl;
+    cout << "Hole Splits: " << profile.holeSplits << endl;
+    cout << "Hole Merges: " << profile.holeMerges << endl;
+    cout << "Queue Ring Growths: " << profile.queueRingGrowths << endl;
+    cout << "Segment Table Growths: " << profile.segmentTableGrowths << endl;
+    cout << "Process Table Growths: " << profile.processTableGrowths << endl;
+    cout << "Heap Allocations: " << profile.heapAllocations << endl;
+    cout << "=============================\n" << endl;
 }
+#endif
 
+// Binary trace format: a BinaryTraceHeader followed by processCount fixed-width records. Every record
+// is the process name (nameWidth bytes, NUL padded) and then arrivalTime, memoryRequirement and
+// executionTimeUnits as native (little-endian) values: uint32 ones, except for a uint64 memoryRequirement
+// in traces with a memory width of 8 (the ones where some process asks for more than 32 bits of memory).
+const char BINARY_TRACE_MAGIC[8] = {'M', 'M', 'T', 'R', 'A', 'C', 'E', '1'};
 
-void sortProcessesByArrivalTime(vector<Process> &processes){
+struct BinaryTraceHeader{
+    char magic[8];
+    uint32_t nameWidth;   // Bytes reserved for the name in every record, multiple of 4
+    uint32_t memoryWidth; // Bytes of memoryRequirement in every record, 8 or else 4 (0 in older traces)
+    uint64_t processCount;
+};
+
+uint32_t binaryTraceMemoryWidth(const BinaryTraceHeader &header){
+    return header.memoryWidth == sizeof(uint64_t) ? sizeof(uint64_t) : sizeof(uint32_t);
+}
+
+struct MappedFile{
+    const char *data;
+    size_t size;
+};
+
+// Maps the whole file in memory (read only). Empty files are valid and have no data.
+bool mapFile(const string &fileName, MappedFile &file){
+    file.data = NULL;
+    file.size = 0;
     
-    //Repetimos la comprobacion hasta que estemos seguros que esta totalmente ordenado
-    for(int i = 1; i < (int)processes.size(); i++){
-        //Recorremos el vector
-        for(int j = 0; j < (int)processes.size() - 1; j++){   //Como compara parejas el último no hace falta analizarlo
-            if(processes[j].arrivalTime > processes[j+1].arrivalTime){
-                //Los valores mas grandes los vamos trasladando al final del vector
-                swap(processes[j], (processes[j+1]));
-            }
+    int descriptor = open(fileName.c_str(), O_RDONLY);
+    if(descriptor == -1)
+    return false;
+    
+    struct stat fileStatus;
+    bool mapped = fstat(descriptor, &fileStatus) == 0;
+    
+    if(mapped && fileStatus.st_size > 0){
+        void *data = mmap(NULL, fileStatus.st_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        
+        if(data == MAP_FAILED)
+        mapped = false;
+        else{
+            madvise(data, fileStatus.st_size, MADV_SEQUENTIAL);
+            file.data = (const char *)data;
+            file.size = fileStatus.st_size;
         }
     }
+    
+    //The mapping keeps the file alive, the descriptor is no longer needed
+    close(descriptor);
+    return mapped;
 }
 
-void insertMemoryHoleAfterIndex(CPU &processor, int holeIndex, int remainingMemoryAmount){
-    Process newHole;
-    newHole.name = "hole";
-    newHole.arrivalTime = 0;
-    newHole.remainingTimeUnits = 0;
-    newHole.executionTimeUnits = 0;
-    newHole.memoryRequirement = remainingMemoryAmount;
-    processor.runningProcesses.push_back(newHole);
+void unmapFile(MappedFile &file){
+    if(file.data != NULL)
+    munmap((void *)file.data, file.size);
     
-    for(int i = processor.runningProcesses.size() - 1 ; i > holeIndex + 1; i--){		
-        swap(processor.runningProcesses[i], processor.runningProcesses[i-1]);
-    }
+    file.data = NULL;
+    file.size = 0;
 }
 
+bool isTraceSeparator(char character){
+    return character == ' ' || character == '\t' || character == '\r';
+}
 
-void decreaseProcessesTimeUnitsAndConvertFinishedIntoHoles(vector<Process> &runningProcesses, Metrics &metrics){
+// Reads an unsigned decimal field starting at cursor (after any separators) and leaves cursor after it.
+// Fails if there are no digits, the value is bigger than maximum or the field has other characters.
+bool parseUnsignedTraceField(const char *&cursor, const char *end, uint64_t maximum, uint64_t &value){
+    while(cursor < end && isTraceSeparator(*cursor))
+    cursor++;
     
-    //Recorremos el vector de processes que se estan ejecutando A LA INVERSA
-    for(int k = runningProcesses.size() - 1; k >= 0 ; k--){
-        
-        //Holes must have unlimited lifetime
-        if(runningProcesses[k].name.compare("hole") != 0)
-        runningProcesses[k].remainingTimeUnits--;
-        
-        //If a process finishes
-        if(runningProcesses[k].remainingTimeUnits == 0 && runningProcesses[k].name.compare("hole") != 0){		
-            //it becomes a hole
-            runningProcesses[k].name = "hole";
-            metrics.processesCompleted++;
-        }   
+    const char *firstDigit = cursor;
+    uint64_t parsedValue = 0;
+    
+    while(cursor < end && *cursor >= '0' && *cursor <= '9'){
+        uint64_t digit = *cursor - '0';
+        if(parsedValue > (maximum - digit) / 10)
+        return false;
+        parsedValue = parsedValue * 10 + digit;
+        cursor++;
     }
+    
+    if(cursor == firstDigit || (cursor < end && !isTraceSeparator(*cursor)))
+    return false;
+    
+    value = parsedValue;
+    return true;
 }
 
-bool shouldContinueSimulation(vector<Process> queue, vector<Process> runningProcesses, int totalMemory){
+bool parseUnsignedTraceField(const char *&cursor, const char *end, unsigned int &value){
+    uint64_t parsedValue;
     
-    bool hasActiveProcesses = false;
+    if(!parseUnsignedTraceField(cursor, end, UINT32_MAX, parsedValue))
+    return false;
     
-    //Si la queue no tiene processes retenidos...
-    if(queue.empty()){
+    value = (unsigned int)parsedValue;
+    return true;
+}
+
+// Reads a memory size of the command line, in memory units: a decimal number of up to 64 bits
+bool parseMemorySize(const char *text, uint64_t &size){
+    const char *cursor = text;
+    return parseUnsignedTraceField(cursor, text + strlen(text), UINT64_MAX, size);
+}
+
+// Whether the simulation can run the process: time units are counted from 1 with an int, so the process
+// must arrive at 1 or later and finish by INT_MAX
+bool hasSimulatedTimes(const Process &process){
+    return process.arrivalTime >= 1 && (uint64_t)process.arrivalTime + process.executionTimeUnits <= (uint64_t)INT_MAX;
+}
+
+// Parses "<name> <arrival> <memory> <exec>" from [line, end). Returns false if the line is malformed,
+// which includes times that the simulation cannot run.
+bool parseTraceLine(const char *line, const char *end, Process &process){
+    const char *cursor = line;
+    
+    while(cursor < end && isTraceSeparator(*cursor))
+    cursor++;
+    
+    const char *nameStart = cursor;
+    while(cursor < end && !isTraceSeparator(*cursor))
+    cursor++;
+    
+    if(cursor == nameStart)
+    return false;
+    
+    process.name.assign(nameStart, cursor - nameStart);
+    
+    //The memory requirement is a 64-bit field, the times are 32-bit ones
+    if(!parseUnsignedTraceField(cursor, end, process.arrivalTime) || !parseUnsignedTraceField(cursor, end, UINT64_MAX, process.memoryRequirement) || !parseUnsignedTraceField(cursor, end, process.executionTimeUnits))
+    return false;
+    
+    //Nothing but separators may follow the last field
+    while(cursor < end && isTraceSeparator(*cursor))
+    cursor++;
+    
+    process.remainingTimeUnits = process.executionTimeUnits;
+    return cursor == end && hasSimulatedTimes(process);
+}
+
+bool isBlankTraceLine(const char *line, const char *end){
+    while(line < end && isTraceSeparator(*line))
+    line++;
+    
+    return line == end;
+}
+
+bool isBinaryTrace(const MappedFile &file){
+    return file.size >= sizeof(BinaryTraceHeader) && memcmp(file.data, BINARY_TRACE_MAGIC, sizeof(BINARY_TRACE_MAGIC)) == 0;
+}
+
+// Sequential reader of a memory-mapped text or binary trace. The pages already read are given back
+// to the system as the reader advances, so only a window of the trace stays resident.
+struct TraceReader{
+    string fileName;
+    MappedFile file;
+    bool binary;
+    const char *cursor;
+    const char *releasedUntil; // Start of the pages that have not been given back yet
+    int lineNumber;            // Line (text traces) or record (binary ones) of the next read
+    uint32_t nameWidth;        // Binary traces: record layout and records left
+    uint32_t memoryWidth;
+    uint64_t remainingRecords;
+};
+
+// Returns false (after reporting it) if the trace cannot be opened or is corrupted
+bool openTraceReader(const string &importFileName, TraceReader &reader){
+    reader.fileName = importFileName;
+    
+    if(!mapFile(importFileName, reader.file)){
+        cout << "Error: The input file '" << importFileName << "' was not found in the current directory or could not be opened." << endl;
+        return false;
+    }
+    
+    reader.binary = isBinaryTrace(reader.file);
+    reader.cursor = reader.file.data;
+    reader.releasedUntil = reader.file.data;
+    reader.lineNumber = 1;
+    reader.nameWidth = 0;
+    reader.memoryWidth = 0;
+    reader.remainingRecords = 0;
+    
+    if(reader.binary){
+        BinaryTraceHeader header;
+        memcpy(&header, reader.file.data, sizeof(header));
         
-        //Cuentas si te quedan processes vivos
-        for(int i = 0; i < (int)runningProcesses.size() && hasActiveProcesses == false; i++){
-            if(runningProcesses[i].remainingTimeUnits != 0)
-            hasActiveProcesses = true;
+        uint64_t recordSize = header.nameWidth + 2 * sizeof(uint32_t) + binaryTraceMemoryWidth(header);
+        if(header.nameWidth == 0 || (reader.file.size - sizeof(header)) / recordSize < header.processCount){
+            cout << "Error: The binary trace '" << importFileName << "' is truncated or corrupted." << endl;
+            unmapFile(reader.file);
+            return false;
         }
         
-        //Always at least we will have a 'hole' process with remainingTimeUnits at 0
-        if(runningProcesses[0].name.compare("hole") == 0 && runningProcesses[0].memoryRequirement == (unsigned int) totalMemory)
-        hasActiveProcesses = false;
-    }    
-    
-    else{
-        //Cuentas si tienes cosas en queue
-        hasActiveProcesses = true;
+        reader.cursor += sizeof(header);
+        reader.nameWidth = header.nameWidth;
+        reader.memoryWidth = binaryTraceMemoryWidth(header);
+        reader.remainingRecords = header.processCount;
     }
     
-    return hasActiveProcesses;
+    return true;
+}
+
+void closeTraceReader(TraceReader &reader){
+    unmapFile(reader.file);
 }
 
-void mergeAdjacentMemoryHoles(vector<Process> &runningProcesses){
+// Gives back to the system the pages that the reader has completely read
+void releaseReadTracePages(TraceReader &reader){
+    const size_t releaseStep = 1 << 20;
     
-    for(int i = (int) runningProcesses.size() -1; i >= 0; i--){
-        //Check if it can be merged with any other adjacent hole
-        //NOTE: keep in mind that we cannot access position k=size
-        if(i < (int) runningProcesses.size()  - 1 &&  runningProcesses[i].name.compare("hole") == 0 && runningProcesses[i+1].name.compare("hole") == 0){
-            runningProcesses[i].memoryRequirement += runningProcesses[i+1].memoryRequirement;
-            //Remove one of the redundant holes
-            runningProcesses.erase(runningProcesses.begin() + i + 1);
-        }
-    }             
+    if(reader.cursor - reader.releasedUntil >= (ptrdiff_t)releaseStep){
+        static const long pageSize = sysconf(_SC_PAGESIZE);
+        size_t readBytes = reader.cursor - reader.file.data;
+        const char *releaseEnd = reader.file.data + readBytes - readBytes % pageSize;
+        
+        madvise((void *)reader.releasedUntil, releaseEnd - reader.releasedUntil, MADV_DONTNEED);
+        reader.releasedUntil = releaseEnd;
+    }
 }
 
-void moveProcessFromQueueToCPU(CPU &processor, bool &wasProcessMoved, Metrics &metrics){
-    int memoryHoleIndex = -1;
+// Reads the next process of the trace. Blank lines are skipped; malformed lines are skipped too and,
+// if reportMalformedLines is set, reported with their line number. Returns false at the end of the trace.
+bool readNextProcess(TraceReader &reader, Process &process, bool reportMalformedLines){
+    const char *end = reader.file.data + reader.file.size;
     
-    // Check if there's a suitable memory hole for the first process in the queue
-    for(int i=0; i < (int) processor.runningProcesses.size() && wasProcessMoved == false; i++){
+    while(reader.binary && reader.remainingRecords != 0){
+        const char *fields = reader.cursor + reader.nameWidth;
+        uint32_t memoryRequirement32;
+        process.name.assign(reader.cursor, strnlen(reader.cursor, reader.nameWidth));
+        memcpy(&process.arrivalTime, fields, sizeof(uint32_t));
         
-        //If the first element of the queue fits in a memory hole
-        if(processor.runningProcesses[i].name.compare("hole") == 0 && processor.queue[0].memoryRequirement <= processor.runningProcesses[i].memoryRequirement){
-            
-            memoryHoleIndex = i;
-            int remainingMemory = processor.runningProcesses[i].memoryRequirement - processor.queue[0].memoryRequirement;
-            
-            //If it fits exactly, simply swap the values
-            if( remainingMemory == 0){
-                swap(processor.runningProcesses[i], processor.queue[0]);
-            }
-            
-            //Otherwise, we need to create a new hole with the remaining memory
-            else{
-                //Shift all processes one position to the right and create the remaining hole
-                insertMemoryHoleAfterIndex(processor, i, remainingMemory);
-                //Insert the process
-                swap(processor.runningProcesses[i], processor.queue[0]);
-                //Merge adjacent holes if any consecutive holes exist
-                mergeAdjacentMemoryHoles(processor.runningProcesses);
-            }
-            
-            //Remove the process from the queue
-            processor.queue.erase(processor.queue.begin());	
-            wasProcessMoved = true;
-            metrics.successfulAllocations++;
-            metrics.allocationFailures--; // Compensate for initial failure count
+        if(reader.memoryWidth == sizeof(uint64_t))
+        memcpy(&process.memoryRequirement, fields + sizeof(uint32_t), sizeof(uint64_t));
+        else{
+            memcpy(&memoryRequirement32, fields + sizeof(uint32_t), sizeof(uint32_t));
+            process.memoryRequirement = memoryRequirement32;
+        }
+        
+        memcpy(&process.executionTimeUnits, fields + sizeof(uint32_t) + reader.memoryWidth, sizeof(uint32_t));
+        process.remainingTimeUnits = process.executionTimeUnits;
+        
+        reader.cursor += reader.nameWidth + 2 * sizeof(uint32_t) + reader.memoryWidth;
+        reader.remainingRecords--;
+        int recordNumber = reader.lineNumber++;
+        
+        if(hasSimulatedTimes(process)){
+            releaseReadTracePages(reader);
+            return true;
+        }
+        
+        if(reportMalformedLines)
+        cout << "Error: record " << recordNumber << " of '" << reader.fileName << "' has times that cannot be simulated and has been skipped: \""
+             << process.name << " " << process.arrivalTime << " " << process.memoryRequirement << " " << process.executionTimeUnits << "\"" << endl;
+    }
+    
+    if(reader.binary)
+    return false;
+    
+    while(reader.cursor < end){
+        const char *lineEnd = (const char *)memchr(reader.cursor, '\n', end - reader.cursor);
+        if(lineEnd == NULL)
+        lineEnd = end;
+        
+        const char *line = reader.cursor;
+        int lineNumber = reader.lineNumber;
+        reader.cursor = lineEnd < end ? lineEnd + 1 : end;
+        reader.lineNumber++;
+        
+        if(parseTraceLine(line, lineEnd, process)){
+            releaseReadTracePages(reader);
+            return true;
         }
+        
+        if(reportMalformedLines && !isBlankTraceLine(line, lineEnd))
+        cout << "Error: line " << lineNumber << " of '" << reader.fileName << "' is malformed and has been skipped: \""
+             << string(line, lineEnd - line) << "\"" << endl;
     }
     
-    if(memoryHoleIndex == -1)
-    wasProcessMoved = false;
+    return false;
+}
+
+// Loads every process of a text or binary trace (detected by its header)
+void loadProcessesFromFile(string importFileName, vector<Process> &processes){
+    TraceReader reader;
+    
+    if(openTraceReader(importFileName, reader)){
+        Process loadedProcess;
+        
+        while(readNextProcess(reader, loadedProcess, true))
+        processes.push_back(loadedProcess);
+        
+        closeTraceReader(reader);
+    }
 }
 
-void allocateProcessToCPU(vector<Process> &processes, CPU &processor, Metrics &metrics){
+// Writes processes as a binary trace. nameWidth must fit every name.
+bool writeBinaryTrace(const string &exportFileName, const vector<Process> &processes, uint32_t nameWidth){
+    BinaryTraceHeader header;
+    memcpy(header.magic, BINARY_TRACE_MAGIC, sizeof(header.magic));
+    header.nameWidth = nameWidth;
+    header.memoryWidth = 0;
+    header.processCount = processes.size();
     
-    int memoryHoleIndex = -1;
+    //Memory requirements take 8 bytes only if some of them needs it
+    for(size_t i = 0; i < processes.size(); i++){
+        if(processes[i].memoryRequirement > UINT32_MAX)
+        header.memoryWidth = sizeof(uint64_t);
+    }
+    uint32_t memoryWidth = binaryTraceMemoryWidth(header);
     
-    // Check if there's a suitable memory hole for the first process
-    for(int i=0; i < (int) processor.runningProcesses.size(); i++){
+    ofstream binaryFile(exportFileName.c_str(), ios::out | ios::binary);
+    if(!binaryFile.is_open())
+    return false;
+    
+    binaryFile.write((const char *)&header, sizeof(header));
+    
+    vector<char> record(nameWidth + 2 * sizeof(uint32_t) + memoryWidth);
+    for(size_t i = 0; i < processes.size(); i++){
+        uint32_t memoryRequirement32 = (uint32_t)processes[i].memoryRequirement;
         
-        //If the first element of the processes vector fits in a memory hole
-        if(processor.runningProcesses[i].name.compare("hole") == 0 && processes[0].memoryRequirement <= processor.runningProcesses[i].memoryRequirement){
-            
-            memoryHoleIndex = i;
-            int remainingMemory = processor.runningProcesses[i].memoryRequirement - processes[0].memoryRequirement;
-            
-            //If it fits exactly, simply swap the values
-            if( remainingMemory == 0){
-                swap(processor.runningProcesses[i], processes[0]);
-            }
-            
-            //Otherwise, we need to create a new hole with the remaining memory
-            else{
-                //Shift all processes one position to the right and create the remaining hole
-                insertMemoryHoleAfterIndex(processor, i, remainingMemory);
-                //Insert the process
-                swap(processor.runningProcesses[i], processes[0]);
-                //Merge adjacent holes if any consecutive holes exist
-                mergeAdjacentMemoryHoles(processor.runningProcesses);
-            }	
-            metrics.successfulAllocations++;
-            break;
-        }
+        memset(&record[0], 0, nameWidth);
+        memcpy(&record[0], processes[i].name.data(), processes[i].name.size());
+        memcpy(&record[nameWidth], &processes[i].arrivalTime, sizeof(uint32_t));
+        
+        if(memoryWidth == sizeof(uint64_t))
+        memcpy(&record[nameWidth + sizeof(uint32_t)], &processes[i].memoryRequirement, sizeof(uint64_t));
+        else
+        memcpy(&record[nameWidth + sizeof(uint32_t)], &memoryRequirement32, sizeof(uint32_t));
+        
+        memcpy(&record[nameWidth + sizeof(uint32_t) + memoryWidth], &processes[i].executionTimeUnits, sizeof(uint32_t));
+        binaryFile.write(&record[0], record.size());
     }
     
-    if(memoryHoleIndex == -1){
-        //If it doesn't fit in any hole, add to queue
-        processor.queue.push_back(processes[0]);
-        metrics.allocationFailures++;
+    binaryFile.close();
+    return !binaryFile.fail();
+}
+
+// Smallest binary trace name width (a multiple of 4) where every name fits
+uint32_t binaryTraceNameWidth(const vector<Process> &processes){
+    uint32_t nameWidth = 4;
+    
+    for(size_t i = 0; i < processes.size(); i++){
+        while(nameWidth < processes[i].name.size())
+        nameWidth += 4;
     }
     
-    processes.erase(processes.begin()); 
+    return nameWidth;
 }
 
-void allocateProcessesUsingFirstFit(int totalMemory, string importFileName, string exportFileName){
+// Converts a text trace into the binary trace format. Returns false if it could not be converted.
+bool convertTextTraceToBinary(const string &importFileName, const string &exportFileName){
     vector<Process> processes;
+    TraceReader reader;
     
-    loadProcessesFromFile(importFileName, processes);
+    if(!openTraceReader(importFileName, reader))
+    return false;
     
-    sortProcessesByArrivalTime(processes);
+    if(reader.binary){
+        cout << "Error: The input file '" << importFileName << "' is already a binary trace." << endl;
+        closeTraceReader(reader);
+        return false;
+    }
+    closeTraceReader(reader);
     
-    // Initialize metrics
-    Metrics metrics;
-    initializeMetrics(metrics);
-    metrics.totalProcesses = processes.size();
+    loadProcessesFromFile(importFileName, processes);
     
-    //Initialize a processor responsible for executing the processes
-    CPU processor;
-    processor.totalMemory = (unsigned int) totalMemory;
+    if(!writeBinaryTrace(exportFileName, processes, binaryTraceNameWidth(processes))){
+        cout << "The output file could not be created" << endl;
+        return false;
+    }
     
-    //Initialize the processor with a hole indicated by parameter
-    Process initialization;
-    initialization.name = "hole";
-    initialization.arrivalTime = 0;
-    initialization.remainingTimeUnits = 0;
-    initialization.executionTimeUnits = 0;
-    initialization.memoryRequirement = totalMemory;
+    cout << processes.size() << " processes converted into the binary trace '" << exportFileName << "'" << endl;
+    return true;
+}
+
+// Workload generator: synthetic traces, sorted by arrival time, that depend only on the seed. The random
+// numbers come from mt19937_64, which is the same everywhere, and are shaped here rather than with the
+// standard distributions, whose results change between standard libraries.
+const int POISSON_ARRIVALS = 0; // Exponential gaps between arrivals
+const int BURSTY_ARRIVALS = 1;  // Bursts of processes arriving in the same time unit, exponential gaps between bursts
+
+const int UNIFORM_DISTRIBUTION = 0;
+const int LOGNORMAL_DISTRIBUTION = 1;   // Median at the geometric mean of the range, which holds 3 standard deviations each side
+const int BIMODAL_DISTRIBUTION = 2;     // 80% in the lowest fifth of the range, 20% in the highest fifth
+const int EXPONENTIAL_DISTRIBUTION = 3; // Minimum plus an exponential with the mean at the middle of the range
+const int DISTRIBUTION_COUNT = 4;
+const char *const DISTRIBUTION_COMMANDS[DISTRIBUTION_COUNT] = {"uniform", "lognormal", "bimodal", "exponential"};
+
+struct WorkloadOptions{
+    string traceFileName;
+    unsigned long long processCount;
+    unsigned long long seed;
+    int arrivalPattern;
+    double arrivalRate;   // Average processes per time unit
+    double burstSize;     // Average processes per burst
+    int sizeDistribution;
+    uint64_t minimumSize;
+    uint64_t maximumSize;
+    int timeDistribution;
+    unsigned int minimumTime;
+    unsigned int maximumTime;
+};
+
+void initializeWorkloadOptions(WorkloadOptions &workload){
+    workload.processCount = 0;
+    workload.seed = 1;
+    workload.arrivalPattern = POISSON_ARRIVALS;
+    workload.arrivalRate = 1;
+    workload.burstSize = 20;
+    workload.sizeDistribution = UNIFORM_DISTRIBUTION;
+    workload.minimumSize = 1;
+    workload.maximumSize = 1000;
+    workload.timeDistribution = UNIFORM_DISTRIBUTION;
+    workload.minimumTime = 1;
+    workload.maximumTime = 20;
+}
+
+// Uniform in [0, 1)
+double randomUnit(mt19937_64 &generator){
+    return (generator() >> 11) * (1.0 / 9007199254740992.0);
+}
+
+double randomExponential(mt19937_64 &generator, double mean){
+    return -mean * log(1 - randomUnit(generator));
+}
+
+double randomStandardNormal(mt19937_64 &generator){
+    double radius = sqrt(-2 * log(1 - randomUnit(generator)));
+    return radius * cos(2 * M_PI * randomUnit(generator));
+}
+
+// A value of the distribution, within [minimum, maximum]
+uint64_t randomWorkloadValue(mt19937_64 &generator, int distribution, uint64_t minimum, uint64_t maximum){
+    double range = (double)maximum - minimum;
+    double value;
     
-    processor.runningProcesses.push_back(initialization);
+    if(distribution == LOGNORMAL_DISTRIBUTION)
+    value = exp((log((double)minimum) + log((double)maximum)) / 2 + randomStandardNormal(generator) * (log((double)maximum) - log((double)minimum)) / 6);
     
-    // true -> continue with the next time instant
-    // false -> stop execution
-    bool shouldContinueExecution = true;
+    else if(distribution == BIMODAL_DISTRIBUTION){
+        if(randomUnit(generator) < 0.8)
+        value = minimum + randomUnit(generator) * (range / 5 + 1);
+        else
+        value = maximum - range / 5 + randomUnit(generator) * (range / 5 + 1);
+    }
     
-    ofstream file_exported;
+    else if(distribution == EXPONENTIAL_DISTRIBUTION)
+    value = minimum + randomExponential(generator, range / 2 + 0.5);
     
-    file_exported.open(exportFileName.c_str(), ios::out);
+    else
+    value = minimum + randomUnit(generator) * (range + 1);
     
-    if(file_exported.is_open()){
-        
-        //Controls the time instants
-        for(int currentTime = 1; shouldContinueExecution == true || !processes.empty(); currentTime++){
-            
-            //Time instant printed to file only
-            file_exported << currentTime << " ";
+    //Clamped as integers: the biggest 64-bit values are not exact as doubles
+    if(value <= (double)minimum)
+    return minimum;
+    if(value >= (double)maximum)
+    return maximum;
+    return (uint64_t)floor(value);
+}
+
+// Writes the trace, one process per line like the hand written ones
+bool generateWorkload(const WorkloadOptions &workload){
+    ofstream trace(workload.traceFileName.c_str());
+    
+    if(!trace){
+        cout << "The output file could not be created" << endl;
+        return false;
+    }
+    
+    mt19937_64 generator(workload.seed);
+    double clock = 0;
+    unsigned long long burstRemaining = 0;
+    
+    for(unsigned long long process = 1; process <= workload.processCount; process++){
+        if(workload.arrivalPattern == BURSTY_ARRIVALS){
+            //A burst starts after an exponential gap and brings a geometric number of processes
+            if(burstRemaining == 0){
+                clock += randomExponential(generator, workload.burstSize / workload.arrivalRate);
+                burstRemaining = 1 + (unsigned long long)floor(randomExponential(generator, workload.burstSize - 0.5));
+            }
+            burstRemaining--;
+        }
+        else
+        clock += randomExponential(generator, 1 / workload.arrivalRate);
+        
+        uint64_t memoryRequirement = randomWorkloadValue(generator, workload.sizeDistribution, workload.minimumSize, workload.maximumSize);
+        unsigned int executionTime = (unsigned int)randomWorkloadValue(generator, workload.timeDistribution, workload.minimumTime, workload.maximumTime);
+        
+        trace << "P" << process << " " << (unsigned long long)clock + 1 << " " << memoryRequirement << " " << executionTime << "\n";
+    }
+    
+    trace.close();
+    if(!trace){
+        cout << "The output file could not be written" << endl;
+        return false;
+    }
+    
+    cout << workload.processCount << " processes generated into the trace '" << workload.traceFileName << "'" << endl;
+    return true;
+}
+
+
+// Stable LSD radix sort by arrival time. It sorts (arrival time, position) pairs, one byte per pass
+// (skipping the bytes that are equal in every key), and then moves every process only once.
+void sortProcessesByArrivalTime(vector<Process> &processes){
+    size_t processCount = processes.size();
+    vector<uint64_t> keys(processCount), sortedKeys(processCount);
+    
+    //Arrival time in the high half, original position in the low half
+    for(size_t i = 0; i < processCount; i++)
+    keys[i] = ((uint64_t)processes[i].arrivalTime << 32) | i;
+    
+    for(int shift = 32; shift < 64; shift += 8){
+        size_t bucketStart[257] = {0};
+        
+        for(size_t i = 0; i < processCount; i++)
+        bucketStart[((keys[i] >> shift) & 0xFF) + 1]++;
+        
+        //All the keys have the same byte: this pass wouldn't move anything
+        if(processCount == 0 || bucketStart[((keys[0] >> shift) & 0xFF) + 1] == processCount)
+        continue;
+        
+        for(int bucket = 0; bucket < 256; bucket++)
+        bucketStart[bucket + 1] += bucketStart[bucket];
+        
+        for(size_t i = 0; i < processCount; i++)
+        sortedKeys[bucketStart[(keys[i] >> shift) & 0xFF]++] = keys[i];
+        
+        keys.swap(sortedKeys);
+    }
+    
+    vector<Process> sortedProcesses(processCount);
+    for(size_t i = 0; i < processCount; i++)
+    swap(sortedProcesses[i], processes[keys[i] & 0xFFFFFFFF]);
+    
+    processes.swap(sortedProcesses);
+}
+
+// Source of arrivals in arrival time order, handed to the simulator in chunks of bounded size:
+// - sorted traces are read straight from the mapped file,
+// - unsorted traces that fit in the sort budget are loaded and sorted in memory,
+// - bigger ones are split into sorted runs on disk that are merged as the simulation advances,
+// - or they come from an already sorted array shared by several simulations (sweep mode).
+const int ARRIVALS_FROM_TRACE = 0;
+const int ARRIVALS_FROM_MEMORY = 1;
+const int ARRIVALS_FROM_RUNS = 2;
+const int ARRIVALS_FROM_SHARED = 3;
+
+struct ArrivalStream{
+    int source;
+    size_t totalProcesses;
+    size_t chunkSize;
+    vector<Process> chunk;  // Next arrivals
+    const Process *pending; // Arrivals being consumed from chunkPosition: the chunk or the shared array
+    size_t pendingCount;
+    size_t chunkPosition;
+    size_t consumedArrivals;
+    uint64_t traceSize;     // Bytes of the trace, 0 for a shared array
+    TraceReader trace;      // ARRIVALS_FROM_TRACE
+    const char *chunkStart; // ARRIVALS_FROM_TRACE: where the chunk was read from, and the reader state there
+    int chunkStartLineNumber;
+    uint64_t chunkStartRemainingRecords;
+    vector<TraceReader> runs; // ARRIVALS_FROM_RUNS: sorted runs and the first unmerged process of each one
+    vector<Process> runHeads;
+    priority_queue<pair<unsigned int, int>, vector<pair<unsigned int, int> >, greater<pair<unsigned int, int> > > runsByArrival;
+};
+
+// Sorts the pending processes of a run and writes them as a binary trace in a temporary file, which is
+// unlinked as soon as it is mapped again for the merge
+bool writeSortedRun(ArrivalStream &arrivals, vector<Process> &runProcesses){
+    const char *temporaryDirectory = getenv("TMPDIR");
+    string runFileName = string(temporaryDirectory != NULL ? temporaryDirectory : "/tmp") + "/memory_management_run_XXXXXX";
+    vector<char> runFileNameBuffer(runFileName.begin(), runFileName.end());
+    runFileNameBuffer.push_back('\0');
+    
+    int descriptor = mkstemp(&runFileNameBuffer[0]);
+    if(descriptor == -1){
+        cout << "Error: a temporary file for sorting the trace could not be created." << endl;
+        return false;
+    }
+    close(descriptor);
+    runFileName = &runFileNameBuffer[0];
+    
+    sortProcessesByArrivalTime(runProcesses);
+    bool written = writeBinaryTrace(runFileName, runProcesses, binaryTraceNameWidth(runProcesses));
+    runProcesses.clear();
+    
+    TraceReader run;
+    if(written && openTraceReader(runFileName, run))
+    arrivals.runs.push_back(run);
+    else
+    written = false;
+    
+    unlink(runFileName.c_str());
+    return written;
+}
+
+// Moves the next chunk of arrivals into arrivals.chunk
+void refillArrivalChunk(ArrivalStream &arrivals){
+    arrivals.chunk.clear();
+    arrivals.chunkPosition = 0;
+    
+    if(arrivals.source == ARRIVALS_FROM_TRACE){
+        Process nextProcess;
+        arrivals.chunkStart = arrivals.trace.cursor;
+        arrivals.chunkStartLineNumber = arrivals.trace.lineNumber;
+        arrivals.chunkStartRemainingRecords = arrivals.trace.remainingRecords;
+        
+        while(arrivals.chunk.size() < arrivals.chunkSize && readNextProcess(arrivals.trace, nextProcess, false))
+        arrivals.chunk.push_back(nextProcess);
+    }
+    
+    else if(arrivals.source == ARRIVALS_FROM_RUNS){
+        while(arrivals.chunk.size() < arrivals.chunkSize && !arrivals.runsByArrival.empty()){
+            //Ties go to the earliest run, which holds the processes that came first in the trace
+            int run = arrivals.runsByArrival.top().second;
+            arrivals.runsByArrival.pop();
+            arrivals.chunk.push_back(arrivals.runHeads[run]);
+            
+            if(readNextProcess(arrivals.runs[run], arrivals.runHeads[run], false))
+            arrivals.runsByArrival.push(make_pair(arrivals.runHeads[run].arrivalTime, run));
+        }
+    }
+    
+    arrivals.pending = arrivals.chunk.data();
+    arrivals.pendingCount = arrivals.chunk.size();
+}
+
+// Prepares the arrivals of a trace. Returns false if the trace cannot be read.
+bool openArrivalStream(const string &importFileName, const SimulationOptions &options, ArrivalStream &arrivals){
+    arrivals.totalProcesses = 0;
+    arrivals.chunkSize = options.arrivalChunkSize;
+    arrivals.chunk.clear();
+    arrivals.pending = NULL;
+    arrivals.pendingCount = 0;
+    arrivals.chunkPosition = 0;
+    arrivals.consumedArrivals = 0;
+    arrivals.runs.clear();
+    arrivals.runHeads.clear();
+    
+    if(!openTraceReader(importFileName, arrivals.trace))
+    return false;
+    
+    //First pass: count the processes, report malformed lines and check whether they are already sorted
+    Process process;
+    bool isSorted = true;
+    unsigned int lastArrivalTime = 0;
+    
+    while(readNextProcess(arrivals.trace, process, true)){
+        if(process.arrivalTime < lastArrivalTime)
+        isSorted = false;
+        
+        lastArrivalTime = process.arrivalTime;
+        arrivals.totalProcesses++;
+    }
+    closeTraceReader(arrivals.trace);
+    
+    if(!openTraceReader(importFileName, arrivals.trace))
+    return false;
+    
+    arrivals.traceSize = arrivals.trace.file.size;
+    
+    if(isSorted)
+    arrivals.source = ARRIVALS_FROM_TRACE;
+    
+    else if(arrivals.totalProcesses <= options.sortMemoryBudget){
+        arrivals.source = ARRIVALS_FROM_MEMORY;
+        
+        arrivals.chunk.reserve(arrivals.totalProcesses);
+        while(readNextProcess(arrivals.trace, process, false))
+        arrivals.chunk.push_back(process);
+        
+        closeTraceReader(arrivals.trace);
+        sortProcessesByArrivalTime(arrivals.chunk);
+        arrivals.pending = arrivals.chunk.data();
+        arrivals.pendingCount = arrivals.chunk.size();
+        return true;
+    }
+    
+    else{
+        //External merge sort: sorted runs of at most sortMemoryBudget processes
+        arrivals.source = ARRIVALS_FROM_RUNS;
+        vector<Process> runProcesses;
+        bool isWritten = true;
+        
+        while(isWritten && readNextProcess(arrivals.trace, process, false)){
+            runProcesses.push_back(process);
+            
+            if(runProcesses.size() == options.sortMemoryBudget)
+            isWritten = writeSortedRun(arrivals, runProcesses);
+        }
+        
+        if(isWritten && !runProcesses.empty())
+        isWritten = writeSortedRun(arrivals, runProcesses);
+        
+        closeTraceReader(arrivals.trace);
+        
+        if(!isWritten)
+        return false;
+        
+        arrivals.runHeads.resize(arrivals.runs.size());
+        for(int run = 0; run < (int)arrivals.runs.size(); run++){
+            if(readNextProcess(arrivals.runs[run], arrivals.runHeads[run], false))
+            arrivals.runsByArrival.push(make_pair(arrivals.runHeads[run].arrivalTime, run));
+        }
+    }
+    
+    refillArrivalChunk(arrivals);
+    return true;
+}
+
+void closeArrivalStream(ArrivalStream &arrivals){
+    if(arrivals.source == ARRIVALS_FROM_TRACE)
+    closeTraceReader(arrivals.trace);
+    
+    for(int run = 0; run < (int)arrivals.runs.size(); run++)
+    closeTraceReader(arrivals.runs[run]);
+    
+    arrivals.runs.clear();
+    arrivals.chunk.clear();
+    arrivals.pending = NULL;
+    arrivals.pendingCount = 0;
+}
+
+// Arrivals read from an array already sorted by arrival time, which is not copied nor modified
+void openSharedArrivalStream(const vector<Process> &processes, ArrivalStream &arrivals){
+    arrivals.source = ARRIVALS_FROM_SHARED;
+    arrivals.totalProcesses = processes.size();
+    arrivals.chunkSize = processes.size();
+    arrivals.chunk.clear();
+    arrivals.pending = processes.data();
+    arrivals.pendingCount = processes.size();
+    arrivals.chunkPosition = 0;
+    arrivals.consumedArrivals = 0;
+    arrivals.traceSize = 0;
+    arrivals.runs.clear();
+    arrivals.runHeads.clear();
+}
+
+bool hasPendingArrivals(const ArrivalStream &arrivals){
+    return arrivals.chunkPosition < arrivals.pendingCount;
+}
+
+// Earliest pending arrival. Only valid while hasPendingArrivals.
+const Process &nextArrival(const ArrivalStream &arrivals){
+    return arrivals.pending[arrivals.chunkPosition];
+}
+
+void popArrival(ArrivalStream &arrivals){
+    arrivals.chunkPosition++;
+    arrivals.consumedArrivals++;
+    
+    if(arrivals.chunkPosition == arrivals.pendingCount && arrivals.source != ARRIVALS_FROM_MEMORY && arrivals.source != ARRIVALS_FROM_SHARED)
+    refillArrivalChunk(arrivals);
+}
+
+// Reads every process of a trace sorted by arrival time. Returns false if the trace cannot be read.
+bool loadSortedArrivals(const string &importFileName, const SimulationOptions &options, vector<Process> &processes){
+    ArrivalStream arrivals;
+    processes.clear();
+    
+    if(!openArrivalStream(importFileName, options, arrivals))
+    return false;
+    
+    processes.reserve(arrivals.totalProcesses);
+    while(hasPendingArrivals(arrivals)){
+        processes.push_back(nextArrival(arrivals));
+        popArrival(arrivals);
+    }
+    
+    closeArrivalStream(arrivals);
+    return true;
+}
+
+// Takes a handle for a copy of process, reusing the slot of a finished process if there is one
+uint32_t addProcessToTable(ProcessTable &table, const Process &process){
+    uint32_t handle;
+    
+    if(!table.freeHandles.empty()){
+        handle = table.freeHandles.back();
+        table.freeHandles.pop_back();
+        table.processes[handle] = process;
+        table.generations[handle]++;
+    }
+    else{
+        PROFILE_COUNT(processTableGrowths, 1);
+        handle = table.processes.size();
+        table.processes.push_back(process);
+        table.generations.push_back(0);
+    }
+    
+    return handle;
+}
+
+void releaseProcessHandle(ProcessTable &table, uint32_t handle){
+    table.freeHandles.push_back(handle);
+}
+
+void initializeProcessTable(ProcessTable &table){
+    table.processes.clear();
+    table.generations.clear();
+    table.freeHandles.clear();
+}
+
+void initializeProcessQueue(ProcessQueue &queue){
+    queue.slots.assign(64, 0);
+    queue.isWaiting.assign(64, 0);
+    queue.head = 0;
+    queue.tail = 0;
+    queue.length = 0;
+    queue.arrivalTimeSum = 0;
+    queue.processesBySize.clear();
+}
+
+uint32_t queuedProcessHandle(const ProcessQueue &queue, uint64_t sequence){
+    return queue.slots[sequence & (queue.slots.size() - 1)];
+}
+
+const Process &queuedProcess(const CPU &processor, uint64_t sequence){
+    return processor.processes.processes[queuedProcessHandle(processor.queue, sequence)];
+}
+
+void pushProcessToQueue(ProcessQueue &queue, const ProcessTable &table, uint32_t handle){
+    const Process &process = table.processes[handle];
+    
+    //Full ring (counting the empty slots still behind the tail): twice the capacity, same sequence numbers
+    if(queue.tail - queue.head == queue.slots.size()){
+        PROFILE_COUNT(queueRingGrowths, 1);
+        vector<uint32_t> slots(queue.slots.size() * 2);
+        vector<uint8_t> isWaiting(slots.size(), 0);
+        
+        for(uint64_t sequence = queue.head; sequence != queue.tail; sequence++){
+            slots[sequence & (slots.size() - 1)] = queue.slots[sequence & (queue.slots.size() - 1)];
+            isWaiting[sequence & (slots.size() - 1)] = queue.isWaiting[sequence & (queue.slots.size() - 1)];
+        }
+        queue.slots.swap(slots);
+        queue.isWaiting.swap(isWaiting);
+    }
+    
+    uint64_t sequence = queue.tail++;
+    queue.slots[sequence & (queue.slots.size() - 1)] = handle;
+    queue.isWaiting[sequence & (queue.slots.size() - 1)] = 1;
+    queue.processesBySize.insert(make_pair(process.memoryRequirement, sequence));
+    queue.length++;
+    queue.arrivalTimeSum += process.arrivalTime;
+}
+
+// Takes any process out of the queue. Its handle is still valid.
+void removeProcessFromQueue(ProcessQueue &queue, const ProcessTable &table, uint64_t sequence){
+    const Process &process = table.processes[queuedProcessHandle(queue, sequence)];
+    
+    queue.processesBySize.erase(make_pair(process.memoryRequirement, sequence));
+    queue.isWaiting[sequence & (queue.slots.size() - 1)] = 0;
+    queue.length--;
+    queue.arrivalTimeSum -= process.arrivalTime;
+    
+    while(queue.head != queue.tail && !queue.isWaiting[queue.head & (queue.slots.size() - 1)])
+    queue.head++;
+}
+
+uint64_t smallestQueuedProcess(const ProcessQueue &queue){
+    return queue.processesBySize.begin()->second;
+}
+
+// The biggest process that asks for at most memoryRequirement units, the oldest one among equally big ones
+uint64_t biggestQueuedProcessUpTo(const ProcessQueue &queue, uint64_t memoryRequirement){
+    QueuedProcessesBySize::const_iterator process = queue.processesBySize.upper_bound(make_pair(memoryRequirement, NO_QUEUED_PROCESS));
+    
+    if(process == queue.processesBySize.begin())
+    return NO_QUEUED_PROCESS;
+    
+    --process;
+    return queue.processesBySize.lower_bound(make_pair(process->first, (uint64_t)0))->second;
+}
+
+// Size class of a hole in the segregated fit index: the first level is the highest bit of the size and
+// the second level the next TLSF_SECOND_LEVEL_LOG2 bits. Sizes below TLSF_SECOND_LEVEL_COUNT have one
+// class each in the first level 0.
+void segregatedFitClass(uint64_t size, int &firstLevel, int &secondLevel){
+    if(size < (uint64_t)TLSF_SECOND_LEVEL_COUNT){
+        firstLevel = 0;
+        secondLevel = size;
+    }
+    else{
+        int highestBit = 63 - __builtin_clzll(size);
+        firstLevel = highestBit - TLSF_SECOND_LEVEL_LOG2 + 1;
+        secondLevel = (size >> (highestBit - TLSF_SECOND_LEVEL_LOG2)) ^ TLSF_SECOND_LEVEL_COUNT;
+    }
+}
+
+void addMemoryHoleToSegregatedFitIndex(CPU &processor, int holeSegment){
+    SegregatedFitIndex &index = processor.segregatedFit;
+    int firstLevel, secondLevel;
+    segregatedFitClass(processor.segments.size[holeSegment], firstLevel, secondLevel);
+    
+    if(holeSegment >= (int)index.nextFreeHole.size()){
+        index.previousFreeHole.resize(processor.segments.size.size(), NO_SEGMENT);
+        index.nextFreeHole.resize(processor.segments.size.size(), NO_SEGMENT);
+    }
+    
+    int &firstHole = index.firstFreeHole[firstLevel][secondLevel];
+    index.previousFreeHole[holeSegment] = NO_SEGMENT;
+    index.nextFreeHole[holeSegment] = firstHole;
+    if(firstHole != NO_SEGMENT)
+    index.previousFreeHole[firstHole] = holeSegment;
+    firstHole = holeSegment;
+    
+    index.firstLevelMap |= 1ull << firstLevel;
+    index.secondLevelMaps[firstLevel] |= 1u << secondLevel;
+}
+
+void removeMemoryHoleFromSegregatedFitIndex(CPU &processor, int holeSegment){
+    SegregatedFitIndex &index = processor.segregatedFit;
+    int firstLevel, secondLevel;
+    segregatedFitClass(processor.segments.size[holeSegment], firstLevel, secondLevel);
+    
+    int previousHole = index.previousFreeHole[holeSegment];
+    int nextHole = index.nextFreeHole[holeSegment];
+    
+    if(previousHole != NO_SEGMENT)
+    index.nextFreeHole[previousHole] = nextHole;
+    else
+    index.firstFreeHole[firstLevel][secondLevel] = nextHole;
+    
+    if(nextHole != NO_SEGMENT)
+    index.previousFreeHole[nextHole] = previousHole;
+    
+    if(index.firstFreeHole[firstLevel][secondLevel] == NO_SEGMENT){
+        index.secondLevelMaps[firstLevel] &= ~(1u << secondLevel);
+        if(index.secondLevelMaps[firstLevel] == 0)
+        index.firstLevelMap &= ~(1ull << firstLevel);
+    }
+}
+
+// First Fit scan kernels: position of the first value of values[0, count) that is at least minimum, count if
+// there is none. They compare 4 (AVX2) or 2 (SSE4.2) values per instruction and stop at the first fit.
+size_t findFirstAtLeastScalar(const uint64_t *values, size_t count, size_t firstPosition, uint64_t minimum){
+    for(size_t i = firstPosition; i < count; i++){
+        if(values[i] >= minimum)
+        return i;
+    }
+    
+    return count;
+}
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+__attribute__((target("avx2")))
+size_t findFirstAtLeastAVX2(const uint64_t *values, size_t count, uint64_t minimum){
+    size_t positions = count - count % 4;
+    //There is only a signed 64-bit comparison: flipping the sign bit of both sides makes it an unsigned one
+    const __m256i signBit = _mm256_set1_epi64x((long long)(1ull << 63));
+    const __m256i requirement = _mm256_xor_si256(_mm256_set1_epi64x((long long)minimum), signBit);
+    
+    for(size_t i = 0; i < positions; i += 4){
+        __m256i value = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)&values[i]), signBit);
+        //value >= minimum <=> !(minimum > value)
+        int fits = ~_mm256_movemask_pd(_mm256_castsi256_pd(_mm256_cmpgt_epi64(requirement, value))) & 0xF;
+        
+        if(fits != 0)
+        return i + __builtin_ctz(fits);
+    }
+    
+    return findFirstAtLeastScalar(values, count, positions, minimum);
+}
+
+__attribute__((target("sse4.2")))
+size_t findFirstAtLeastSSE42(const uint64_t *values, size_t count, uint64_t minimum){
+    size_t positions = count - count % 2;
+    const __m128i signBit = _mm_set1_epi64x((long long)(1ull << 63));
+    const __m128i requirement = _mm_xor_si128(_mm_set1_epi64x((long long)minimum), signBit);
+    
+    for(size_t i = 0; i < positions; i += 2){
+        __m128i value = _mm_xor_si128(_mm_loadu_si128((const __m128i *)&values[i]), signBit);
+        int fits = ~_mm_movemask_pd(_mm_castsi128_pd(_mm_cmpgt_epi64(requirement, value))) & 0x3;
+        
+        if(fits != 0)
+        return i + __builtin_ctz(fits);
+    }
+    
+    return findFirstAtLeastScalar(values, count, positions, minimum);
+}
+#endif
+
+size_t findFirstAtLeast(const uint64_t *values, size_t count, uint64_t minimum){
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+    static const bool hasAVX2 = __builtin_cpu_supports("avx2");
+    static const bool hasSSE42 = __builtin_cpu_supports("sse4.2");
+    
+    if(hasAVX2)
+    return findFirstAtLeastAVX2(values, count, minimum);
+    if(hasSSE42)
+    return findFirstAtLeastSSE42(values, count, minimum);
+#endif
+    return findFirstAtLeastScalar(values, count, 0, minimum);
+}
+
+// Position, in address order, of the block where a hole starting at startAddress is or goes: the last
+// one that starts at or before it, or the first one
+size_t firstFitBlockPosition(const FirstFitIndex &index, uint64_t startAddress){
+    size_t position = upper_bound(index.blockFirstAddress.begin(), index.blockFirstAddress.end(), startAddress) - index.blockFirstAddress.begin();
+    return position == 0 ? 0 : position - 1;
+}
+
+// Adds an empty block at the given position of the address order
+void insertFirstFitBlock(FirstFitIndex &index, size_t position){
+    int block;
+    
+    if(!index.unusedBlocks.empty()){
+        block = index.unusedBlocks.back();
+        index.unusedBlocks.pop_back();
+    }
+    else{
+        block = index.blocks.size();
+        index.blocks.push_back(FirstFitBlock());
+    }
+    
+    index.blocks[block].holeCount = 0;
+    index.blockOrder.insert(index.blockOrder.begin() + position, block);
+    index.blockFirstAddress.insert(index.blockFirstAddress.begin() + position, 0);
+    index.blockLargestSize.insert(index.blockLargestSize.begin() + position, 0);
+}
+
+void updateFirstFitBlockSummary(FirstFitIndex &index, size_t position){
+    const FirstFitBlock &block = index.blocks[index.blockOrder[position]];
+    
+    index.blockFirstAddress[position] = block.startAddress[0];
+    index.blockLargestSize[position] = *max_element(block.size, block.size + block.holeCount);
+}
+
+// Moves the holes of the block after position to the end of the block at position, and drops the emptied block
+void mergeFirstFitBlocks(FirstFitIndex &index, size_t position){
+    FirstFitBlock &block = index.blocks[index.blockOrder[position]];
+    FirstFitBlock &nextBlock = index.blocks[index.blockOrder[position + 1]];
+    
+    memcpy(block.startAddress + block.holeCount, nextBlock.startAddress, nextBlock.holeCount * sizeof(uint64_t));
+    memcpy(block.size + block.holeCount, nextBlock.size, nextBlock.holeCount * sizeof(uint64_t));
+    memcpy(block.segment + block.holeCount, nextBlock.segment, nextBlock.holeCount * sizeof(int));
+    block.holeCount += nextBlock.holeCount;
+    index.blockLargestSize[position] = max(index.blockLargestSize[position], index.blockLargestSize[position + 1]);
+    
+    index.unusedBlocks.push_back(index.blockOrder[position + 1]);
+    index.blockOrder.erase(index.blockOrder.begin() + position + 1);
+    index.blockFirstAddress.erase(index.blockFirstAddress.begin() + position + 1);
+    index.blockLargestSize.erase(index.blockLargestSize.begin() + position + 1);
+}
+
+// Moves the upper half of a full block to a new block right after it
+void splitFirstFitBlock(FirstFitIndex &index, size_t position){
+    insertFirstFitBlock(index, position + 1);
+    
+    FirstFitBlock &block = index.blocks[index.blockOrder[position]];
+    FirstFitBlock &upperBlock = index.blocks[index.blockOrder[position + 1]];
+    uint32_t half = block.holeCount / 2;
+    
+    upperBlock.holeCount = block.holeCount - half;
+    memcpy(upperBlock.startAddress, block.startAddress + half, upperBlock.holeCount * sizeof(uint64_t));
+    memcpy(upperBlock.size, block.size + half, upperBlock.holeCount * sizeof(uint64_t));
+    memcpy(upperBlock.segment, block.segment + half, upperBlock.holeCount * sizeof(int));
+    block.holeCount = half;
+    
+    updateFirstFitBlockSummary(index, position);
+    updateFirstFitBlockSummary(index, position + 1);
+}
+
+void addMemoryHoleToFirstFitIndex(CPU &processor, int holeSegment){
+    FirstFitIndex &index = processor.firstFit;
+    uint64_t startAddress = processor.segments.startAddress[holeSegment];
+    uint64_t size = processor.segments.size[holeSegment];
+    
+    if(index.blockOrder.empty())
+    insertFirstFitBlock(index, 0);
+    
+    size_t position = firstFitBlockPosition(index, startAddress);
+    
+    if(index.blocks[index.blockOrder[position]].holeCount == (uint32_t)FIRST_FIT_BLOCK_CAPACITY){
+        splitFirstFitBlock(index, position);
+        if(startAddress >= index.blockFirstAddress[position + 1])
+        position++;
+    }
+    
+    FirstFitBlock &block = index.blocks[index.blockOrder[position]];
+    uint32_t hole = lower_bound(block.startAddress, block.startAddress + block.holeCount, startAddress) - block.startAddress;
+    uint32_t movedHoles = block.holeCount - hole;
+    
+    memmove(block.startAddress + hole + 1, block.startAddress + hole, movedHoles * sizeof(uint64_t));
+    memmove(block.size + hole + 1, block.size + hole, movedHoles * sizeof(uint64_t));
+    memmove(block.segment + hole + 1, block.segment + hole, movedHoles * sizeof(int));
+    block.startAddress[hole] = startAddress;
+    block.size[hole] = size;
+    block.segment[hole] = holeSegment;
+    block.holeCount++;
+    
+    index.blockFirstAddress[position] = block.startAddress[0];
+    index.blockLargestSize[position] = max(index.blockLargestSize[position], size);
+}
+
+void removeMemoryHoleFromFirstFitIndex(CPU &processor, int holeSegment){
+    FirstFitIndex &index = processor.firstFit;
+    uint64_t startAddress = processor.segments.startAddress[holeSegment];
+    size_t position = firstFitBlockPosition(index, startAddress);
+    FirstFitBlock &block = index.blocks[index.blockOrder[position]];
+    uint32_t hole = lower_bound(block.startAddress, block.startAddress + block.holeCount, startAddress) - block.startAddress;
+    uint32_t movedHoles = block.holeCount - hole - 1;
+    
+    memmove(block.startAddress + hole, block.startAddress + hole + 1, movedHoles * sizeof(uint64_t));
+    memmove(block.size + hole, block.size + hole + 1, movedHoles * sizeof(uint64_t));
+    memmove(block.segment + hole, block.segment + hole + 1, movedHoles * sizeof(int));
+    block.holeCount--;
+    
+    if(block.holeCount == 0){
+        index.unusedBlocks.push_back(index.blockOrder[position]);
+        index.blockOrder.erase(index.blockOrder.begin() + position);
+        index.blockFirstAddress.erase(index.blockFirstAddress.begin() + position);
+        index.blockLargestSize.erase(index.blockLargestSize.begin() + position);
+        return;
+    }
+    
+    updateFirstFitBlockSummary(index, position);
+    
+    //Sparse neighbours are merged, so the number of blocks follows the number of holes
+    uint32_t mergeLimit = FIRST_FIT_BLOCK_CAPACITY / 2;
+    
+    if(position + 1 < index.blockOrder.size() && block.holeCount + index.blocks[index.blockOrder[position + 1]].holeCount <= mergeLimit)
+    mergeFirstFitBlocks(index, position);
+    else if(position > 0 && block.holeCount + index.blocks[index.blockOrder[position - 1]].holeCount <= mergeLimit)
+    mergeFirstFitBlocks(index, position - 1);
+}
+
+// Indexes the holes of the memory map by address as well, for First Fit
+void initializeFirstFitIndex(CPU &processor){
+    FirstFitIndex &index = processor.firstFit;
+    
+    index.blocks.clear();
+    index.unusedBlocks.clear();
+    index.blockOrder.clear();
+    index.blockFirstAddress.clear();
+    index.blockLargestSize.clear();
+    processor.indexesHolesByAddress = true;
+    
+    for(int segment = processor.firstSegment; segment != NO_SEGMENT; segment = processor.segments.nextSegment[segment]){
+        if(processor.segments.state[segment] == HOLE_SEGMENT)
+        addMemoryHoleToFirstFitIndex(processor, segment);
+    }
+}
+
+void addMemoryHoleToIndex(CPU &processor, int holeSegment){
+    processor.holeCount++;
+    
+    if(processor.indexesHolesByAddress)
+    addMemoryHoleToFirstFitIndex(processor, holeSegment);
+    
+    if(processor.holeIndex == HOLE_INDEX_BY_SIZE)
+    processor.memoryHolesBySize[make_pair(processor.segments.size[holeSegment], processor.segments.startAddress[holeSegment])] = holeSegment;
+    
+    else if(processor.holeIndex == HOLE_INDEX_SEGREGATED_FIT)
+    addMemoryHoleToSegregatedFitIndex(processor, holeSegment);
+}
+
+void removeMemoryHoleFromIndex(CPU &processor, int holeSegment){
+    processor.holeCount--;
+    
+    if(processor.indexesHolesByAddress)
+    removeMemoryHoleFromFirstFitIndex(processor, holeSegment);
+    
+    if(processor.holeIndex == HOLE_INDEX_BY_SIZE)
+    processor.memoryHolesBySize.erase(make_pair(processor.segments.size[holeSegment], processor.segments.startAddress[holeSegment]));
+    
+    else if(processor.holeIndex == HOLE_INDEX_SEGREGATED_FIT)
+    removeMemoryHoleFromSegregatedFitIndex(processor, holeSegment);
+}
+
+// Indexes the holes of the memory map (right after initializeMemory, a single one) by size class
+void initializeSegregatedFitIndex(CPU &processor){
+    SegregatedFitIndex &index = processor.segregatedFit;
+    
+    index.firstLevelMap = 0;
+    for(int firstLevel = 0; firstLevel < TLSF_FIRST_LEVEL_COUNT; firstLevel++){
+        index.secondLevelMaps[firstLevel] = 0;
+        for(int secondLevel = 0; secondLevel < TLSF_SECOND_LEVEL_COUNT; secondLevel++)
+        index.firstFreeHole[firstLevel][secondLevel] = NO_SEGMENT;
+    }
+    index.previousFreeHole.clear();
+    index.nextFreeHole.clear();
+    
+    processor.memoryHolesBySize.clear();
+    processor.holeIndex = HOLE_INDEX_SEGREGATED_FIT;
+    
+    for(int segment = processor.firstSegment; segment != NO_SEGMENT; segment = processor.segments.nextSegment[segment]){
+        if(processor.segments.state[segment] == HOLE_SEGMENT)
+        addMemoryHoleToSegregatedFitIndex(processor, segment);
+    }
+}
+
+// TLSF (two-level segregated fit): the requirement is rounded up to the next size class, so any hole of
+// that class or a bigger one fits, and the first non-empty class is found with two bit scans. It does not
+// depend on the number of holes. If no such class exists, the first hole of the requirement's own class
+// is tried, which may be big enough (e.g. the whole memory when it is empty). That depends on the order of
+// the list, so the event-driven mode does not skip the time unit after a placement (see fitsDependOnListOrder).
+int findSegregatedFitMemoryHole(const CPU &processor, uint64_t memoryRequirement){
+    const SegregatedFitIndex &index = processor.segregatedFit;
+    int firstLevel, secondLevel;
+    uint32_t secondLevelMap = 0;
+    
+    uint64_t classRounding = 0;
+    if(memoryRequirement >= (uint64_t)TLSF_SECOND_LEVEL_COUNT)
+    classRounding = (1ull << (63 - __builtin_clzll(memoryRequirement) - TLSF_SECOND_LEVEL_LOG2)) - 1;
+    
+    if(memoryRequirement <= UINT64_MAX - classRounding){
+        segregatedFitClass(memoryRequirement + classRounding, firstLevel, secondLevel);
+        secondLevelMap = index.secondLevelMaps[firstLevel] & (~0u << secondLevel);
+        
+        //Nothing in the rest of this first level: the smallest bigger first level with holes
+        if(secondLevelMap == 0){
+            uint64_t firstLevelMap = index.firstLevelMap & (~0ull << (firstLevel + 1));
+            
+            if(firstLevelMap != 0){
+                firstLevel = __builtin_ctzll(firstLevelMap);
+                secondLevelMap = index.secondLevelMaps[firstLevel];
+            }
+        }
+    }
+    
+    if(secondLevelMap != 0)
+    return index.firstFreeHole[firstLevel][__builtin_ctz(secondLevelMap)];
+    
+    segregatedFitClass(memoryRequirement, firstLevel, secondLevel);
+    int hole = index.firstFreeHole[firstLevel][secondLevel];
+    
+    if(hole != NO_SEGMENT && processor.segments.size[hole] >= memoryRequirement)
+    return hole;
+    
+    return NO_SEGMENT;
+}
+
+// Upper limit of the biggest size class with holes. The holes of that class may be smaller.
+uint64_t largestSegregatedFitClassSize(const CPU &processor){
+    const SegregatedFitIndex &index = processor.segregatedFit;
+    
+    if(index.firstLevelMap == 0)
+    return 0;
+    
+    int firstLevel = 63 - __builtin_clzll(index.firstLevelMap);
+    int secondLevel = 31 - __builtin_clz(index.secondLevelMaps[firstLevel]);
+    
+    if(firstLevel == 0)
+    return secondLevel;
+    
+    int classShift = firstLevel - 1;
+    uint64_t classEnd = (uint64_t)(TLSF_SECOND_LEVEL_COUNT + secondLevel + 1) << classShift;
+    
+    //The last class of the last first level ends at 2^64
+    if(classEnd == 0)
+    return UINT64_MAX;
+    
+    return classEnd - 1;
+}
+
+// Smallest hole where memoryRequirement fits, the lowest address one among equally sized holes.
+// Returns NO_SEGMENT if no hole is big enough.
+int findBestFitMemoryHole(const CPU &processor, uint64_t memoryRequirement){
+    MemoryHolesBySize::const_iterator bestHole = processor.memoryHolesBySize.lower_bound(make_pair(memoryRequirement, (uint64_t)0));
+    
+    if(bestHole == processor.memoryHolesBySize.end())
+    return NO_SEGMENT;
+    
+    return bestHole->second;
+}
+
+// Hole with the lowest address where memoryRequirement fits. Returns NO_SEGMENT if no hole is big enough.
+int findFirstFitMemoryHole(const CPU &processor, uint64_t memoryRequirement){
+    const FirstFitIndex &index = processor.firstFit;
+    size_t position = findFirstAtLeast(index.blockLargestSize.data(), index.blockLargestSize.size(), memoryRequirement);
+    
+    if(position == index.blockLargestSize.size())
+    return NO_SEGMENT;
+    
+    //The biggest hole of the block fits, so the scan of the block always finds one
+    const FirstFitBlock &block = index.blocks[index.blockOrder[position]];
+    size_t hole = findFirstAtLeast(block.size, block.holeCount, memoryRequirement);
+    
+    PROFILE_COUNT(scannedSegments, position + hole + 1);
+    return block.segment[hole];
+}
+
+// Next Fit: walks the memory map from the rover (the hole chosen last time) to the end and then from
+// the beginning, so the low addresses are not searched again on every placement. The rover is left on
+// the chosen hole.
+int findNextFitMemoryHole(CPU &processor, uint64_t memoryRequirement){
+    const SegmentTable &segments = processor.segments;
+    
+    //The biggest hole tells right away whether the walk can succeed, so it always finds a hole
+    if(processor.memoryHolesBySize.empty() || processor.memoryHolesBySize.rbegin()->first.first < memoryRequirement)
+    return NO_SEGMENT;
+    
+    int segment = processor.nextFitSegment;
+    
+    while(segments.state[segment] != HOLE_SEGMENT || segments.size[segment] < memoryRequirement){
+        segment = segments.nextSegment[segment];
+        
+        if(segment == NO_SEGMENT)
+        segment = processor.firstSegment;
+        
+        PROFILE_COUNT(scannedSegments, 1);
+    }
+    
+    processor.nextFitSegment = segment;
+    return segment;
+}
+
+// Worst Fit: the biggest hole, the one with the lowest address if several are equally big. It is the
+// last size of the hole index, which works as a max-heap that is also kept up to date when holes merge.
+int findWorstFitMemoryHole(const CPU &processor, uint64_t memoryRequirement){
+    if(processor.memoryHolesBySize.empty())
+    return NO_SEGMENT;
+    
+    uint64_t biggestSize = processor.memoryHolesBySize.rbegin()->first.first;
+    if(biggestSize < memoryRequirement)
+    return NO_SEGMENT;
+    
+    return processor.memoryHolesBySize.lower_bound(make_pair(biggestSize, (uint64_t)0))->second;
+}
+
+const string &memorySegmentName(const CPU &processor, int segment){
+    static const string holeName = "hole";
+    
+    if(processor.segments.state[segment] == HOLE_SEGMENT)
+    return holeName;
+    
+    return processor.processes.processes[processor.segments.processId[segment]].name;
+}
+
+// Takes a position of the segment table (reusing the ones left by merged holes) for a hole.
+// The new segment is not linked to any neighbour yet.
+int newMemoryHoleSegment(CPU &processor, uint64_t startAddress, uint64_t size){
+    SegmentTable &segments = processor.segments;
+    int segment;
+    
+    if(!processor.unusedSegments.empty()){
+        segment = processor.unusedSegments.back();
+        processor.unusedSegments.pop_back();
+    }
+    else{
+        PROFILE_COUNT(segmentTableGrowths, 1);
+        segment = segments.size.size();
+        segments.startAddress.push_back(0);
+        segments.size.push_back(0);
+        segments.state.push_back(UNUSED_SEGMENT);
+        segments.processId.push_back(0);
+        segments.finishTime.push_back(0);
+        segments.requestedSize.push_back(0);
+        segments.previousSegment.push_back(NO_SEGMENT);
+        segments.nextSegment.push_back(NO_SEGMENT);
+    }
+    
+    segments.startAddress[segment] = startAddress;
+    segments.size[segment] = size;
+    segments.state[segment] = HOLE_SEGMENT;
+    segments.processId[segment] = 0;
+    segments.finishTime[segment] = 0;
+    segments.requestedSize[segment] = 0;
+    segments.previousSegment[segment] = NO_SEGMENT;
+    segments.nextSegment[segment] = NO_SEGMENT;
+    
+    return segment;
+}
+
+// Granules taken by a process of memoryRequirement units, which is rounded up to whole granules
+uint64_t requiredGranules(const CPU &processor, uint64_t memoryRequirement){
+    return memoryRequirement / processor.granularity + (memoryRequirement % processor.granularity != 0);
+}
+
+// Leaves the whole memory as a single hole of totalMemory granules, of granularity memory units each
+void initializeMemory(CPU &processor, uint64_t totalMemory, uint64_t granularity){
+    processor.granularity = granularity;
+    processor.totalMemory = totalMemory;
+    processor.maximumPlacementSize = totalMemory;
+    processor.holeIndex = HOLE_INDEX_BY_SIZE;
+    processor.indexesHolesByAddress = false;
+    processor.hasPlacedSinceQueueRetry = false;
+    processor.segments = SegmentTable();
+    processor.unusedSegments.clear();
+    processor.memoryHolesBySize.clear();
+    initializeProcessTable(processor.processes);
+    processor.elapsedTimeUnits = 0;
+    processor.stalledTimeUnits = 0;
+    processor.usedMemory = 0;
+    processor.holeCount = 0;
+    processor.internalFragmentation = 0;
+    processor.completions = priority_queue<pair<uint64_t, int>, vector<pair<uint64_t, int> >, greater<pair<uint64_t, int> > >();
+    initializeProcessQueue(processor.queue);
+    processor.firstSegment = newMemoryHoleSegment(processor, 0, totalMemory);
+    processor.nextFitSegment = processor.firstSegment;
+    addMemoryHoleToIndex(processor, processor.firstSegment);
+}
+
+void insertMemoryHoleAfterIndex(CPU &processor, int holeSegment, uint64_t remainingMemoryAmount){
+    uint64_t startAddress = processor.segments.startAddress[holeSegment] + processor.segments.size[holeSegment] - remainingMemoryAmount;
+    int newSegment = newMemoryHoleSegment(processor, startAddress, remainingMemoryAmount);
+    int nextSegment = processor.segments.nextSegment[holeSegment];
+    
+    PROFILE_COUNT(holeSplits, 1);
+    
+    //Link the new hole between holeSegment and its right neighbour
+    processor.segments.previousSegment[newSegment] = holeSegment;
+    processor.segments.nextSegment[newSegment] = nextSegment;
+    processor.segments.nextSegment[holeSegment] = newSegment;
+    if(nextSegment != NO_SEGMENT)
+    processor.segments.previousSegment[nextSegment] = newSegment;
+    
+    addMemoryHoleToIndex(processor, newSegment);
+}
+
+// Places the process of the handle at the beginning of holeSegment, taking occupiedMemory units (its
+// memory requirement, unless the placement rounds it up) and leaving the rest of the hole free
+void placeProcessInMemoryHole(CPU &processor, int holeSegment, uint32_t handle, uint64_t occupiedMemory){
+    const Process &process = processor.processes.processes[handle];
+    uint64_t granules = requiredGranules(processor, process.memoryRequirement);
+    uint64_t remainingMemory = processor.segments.size[holeSegment] - occupiedMemory;
+    
+    removeMemoryHoleFromIndex(processor, holeSegment);
+    
+    //If it doesn't fit exactly, we need to create a new hole with the remaining memory.
+    //Its right neighbour was never a hole (holes are always merged), so no merge is needed afterwards
+    if(remainingMemory != 0)
+    insertMemoryHoleAfterIndex(processor, holeSegment, remainingMemory);
+    
+    processor.segments.size[holeSegment] = occupiedMemory;
+    processor.segments.requestedSize[holeSegment] = granules;
+    processor.segments.state[holeSegment] = PROCESS_SEGMENT;
+    processor.segments.processId[holeSegment] = handle;
+    processor.segments.finishTime[holeSegment] = processor.elapsedTimeUnits + process.remainingTimeUnits;
+    processor.completions.push(make_pair(processor.segments.finishTime[holeSegment], holeSegment));
+    processor.usedMemory += occupiedMemory;
+    processor.internalFragmentation += occupiedMemory - granules;
+    processor.hasPlacedSinceQueueRetry = true;
+}
+
+// Merges the hole right after holeSegment into it and releases its position in the segment table
+void absorbNextMemoryHole(CPU &processor, int holeSegment){
+    SegmentTable &segments = processor.segments;
+    int absorbedSegment = segments.nextSegment[holeSegment];
+    int nextSegment = segments.nextSegment[absorbedSegment];
+    
+    PROFILE_COUNT(holeMerges, 1);
+    removeMemoryHoleFromIndex(processor, holeSegment);
+    removeMemoryHoleFromIndex(processor, absorbedSegment);
+    
+    segments.size[holeSegment] += segments.size[absorbedSegment];
+    segments.nextSegment[holeSegment] = nextSegment;
+    if(nextSegment != NO_SEGMENT)
+    segments.previousSegment[nextSegment] = holeSegment;
+    
+    segments.state[absorbedSegment] = UNUSED_SEGMENT;
+    processor.unusedSegments.push_back(absorbedSegment);
+    addMemoryHoleToIndex(processor, holeSegment);
+    
+    //The rover stays on the memory it pointed to
+    if(processor.nextFitSegment == absorbedSegment)
+    processor.nextFitSegment = holeSegment;
+}
+
+// Coalesces holeSegment with the holes right before and after it, if any.
+// Returns the segment holding the merged hole.
+int mergeMemoryHoleWithNeighbours(CPU &processor, int holeSegment){
+    int nextSegment = processor.segments.nextSegment[holeSegment];
+    int previousSegment = processor.segments.previousSegment[holeSegment];
+    
+    if(nextSegment != NO_SEGMENT && processor.segments.state[nextSegment] == HOLE_SEGMENT)
+    absorbNextMemoryHole(processor, holeSegment);
+    
+    if(previousSegment != NO_SEGMENT && processor.segments.state[previousSegment] == HOLE_SEGMENT){
+        absorbNextMemoryHole(processor, previousSegment);
+        holeSegment = previousSegment;
+    }
+    
+    return holeSegment;
+}
+
+
+// Compaction: slides the processes of the run of consecutive segments firstSegment..lastSegment toward
+// the start of the run, so that all its holes become a single hole at its end. Moved segments keep their
+// position in the segment table. Returns that hole, merged with the next one if it is a hole as well.
+int compactMemorySegments(CPU &processor, int firstSegment, int lastSegment, long long &movedMemory){
+    SegmentTable &segments = processor.segments;
+    int linkedSegment = segments.previousSegment[firstSegment]; // Last segment already relinked
+    int afterSegment = segments.nextSegment[lastSegment];
+    uint64_t writeAddress = segments.startAddress[firstSegment];
+    uint64_t holeSize = 0;
+    int holeSegment = NO_SEGMENT; // The first hole of the run is reused for the compacted one
+    
+    movedMemory = 0;
+    
+    for(int segment = firstSegment, nextSegment; ; segment = nextSegment){
+        nextSegment = segments.nextSegment[segment];
+        
+        if(segments.state[segment] == HOLE_SEGMENT){
+            removeMemoryHoleFromIndex(processor, segment);
+            holeSize += segments.size[segment];
+            
+            if(holeSegment == NO_SEGMENT)
+            holeSegment = segment;
+            else{
+                segments.state[segment] = UNUSED_SEGMENT;
+                processor.unusedSegments.push_back(segment);
+                
+                if(processor.nextFitSegment == segment)
+                processor.nextFitSegment = holeSegment;
+            }
+        }
+        else{
+            if(segments.startAddress[segment] != writeAddress){
+                movedMemory += segments.size[segment];
+                segments.startAddress[segment] = writeAddress;
+            }
+            writeAddress += segments.size[segment];
+            
+            segments.previousSegment[segment] = linkedSegment;
+            if(linkedSegment == NO_SEGMENT)
+            processor.firstSegment = segment;
+            else
+            segments.nextSegment[linkedSegment] = segment;
+            linkedSegment = segment;
+        }
+        
+        if(segment == lastSegment)
+        break;
+    }
+    
+    segments.startAddress[holeSegment] = writeAddress;
+    segments.size[holeSegment] = holeSize;
+    segments.previousSegment[holeSegment] = linkedSegment;
+    if(linkedSegment == NO_SEGMENT)
+    processor.firstSegment = holeSegment;
+    else
+    segments.nextSegment[linkedSegment] = holeSegment;
+    
+    segments.nextSegment[holeSegment] = afterSegment;
+    if(afterSegment != NO_SEGMENT)
+    segments.previousSegment[afterSegment] = holeSegment;
+    
+    addMemoryHoleToIndex(processor, holeSegment);
+    return mergeMemoryHoleWithNeighbours(processor, holeSegment);
+}
+
+// Run of consecutive segments to compact so that a hole of memoryRequirement units appears. The whole
+// memory, or (partial compaction) the run whose holes add up to memoryRequirement moving the least
+// memory, found in a single pass: for every hole that may end the run, the run starts at the latest hole
+// that still leaves enough free memory. Returns false if not even all the holes together are enough.
+bool findCompactionRun(const CPU &processor, uint64_t memoryRequirement, bool compactWholeMemory, int &firstSegment, int &lastSegment){
+    const SegmentTable &segments = processor.segments;
+    unsigned long long runHoles = 0, runProcesses = 0, leastMovedMemory = 0;
+    int runStart = processor.firstSegment;
+    bool isFound = false;
+    
+    for(int segment = processor.firstSegment; segment != NO_SEGMENT; segment = segments.nextSegment[segment]){
+        PROFILE_COUNT(scannedSegments, 1);
+        
+        if(segments.state[segment] == HOLE_SEGMENT)
+        runHoles += segments.size[segment];
+        else
+        runProcesses += segments.size[segment];
+        
+        if(compactWholeMemory){
+            lastSegment = segment;
+            continue;
+        }
+        
+        //Processes before the first hole of the run would not move, and holes can be left out while
+        //the rest are enough
+        while(runStart != segment && (segments.state[runStart] != HOLE_SEGMENT || runHoles - segments.size[runStart] >= memoryRequirement)){
+            if(segments.state[runStart] == HOLE_SEGMENT)
+            runHoles -= segments.size[runStart];
+            else
+            runProcesses -= segments.size[runStart];
+            
+            runStart = segments.nextSegment[runStart];
+        }
+        
+        if(segments.state[segment] == HOLE_SEGMENT && runHoles >= memoryRequirement && (!isFound || runProcesses < leastMovedMemory)){
+            isFound = true;
+            leastMovedMemory = runProcesses;
+            firstSegment = runStart;
+            lastSegment = segment;
+        }
+    }
+    
+    if(compactWholeMemory){
+        firstSegment = processor.firstSegment;
+        isFound = runHoles >= memoryRequirement;
+    }
+    
+    return isFound;
+}
+
+// Buddy system. Every block is a segment of the memory map, so the blocks are also what the dump shows.
+// Free blocks are kept in one doubly linked list per order, and nonEmptyOrders tells which lists have
+// blocks, so the smallest available order is found with a single bit scan. The buddy of a block is
+// always its neighbour in the memory map, which makes finding it O(1).
+void addFreeBuddyBlock(CPU &processor, int blockSegment){
+    BuddyAllocator &buddy = processor.buddy;
+    int order = __builtin_ctzll(processor.segments.size[blockSegment]);
+    
+    if(blockSegment >= (int)buddy.nextFreeBlock.size()){
+        buddy.previousFreeBlock.resize(processor.segments.size.size(), NO_SEGMENT);
+        buddy.nextFreeBlock.resize(processor.segments.size.size(), NO_SEGMENT);
+    }
+    
+    buddy.previousFreeBlock[blockSegment] = NO_SEGMENT;
+    buddy.nextFreeBlock[blockSegment] = buddy.firstFreeBlock[order];
+    if(buddy.firstFreeBlock[order] != NO_SEGMENT)
+    buddy.previousFreeBlock[buddy.firstFreeBlock[order]] = blockSegment;
+    
+    buddy.firstFreeBlock[order] = blockSegment;
+    buddy.nonEmptyOrders |= 1ull << order;
+}
+
+void removeFreeBuddyBlock(CPU &processor, int blockSegment){
+    BuddyAllocator &buddy = processor.buddy;
+    int order = __builtin_ctzll(processor.segments.size[blockSegment]);
+    int previousBlock = buddy.previousFreeBlock[blockSegment];
+    int nextBlock = buddy.nextFreeBlock[blockSegment];
+    
+    if(previousBlock != NO_SEGMENT)
+    buddy.nextFreeBlock[previousBlock] = nextBlock;
+    else
+    buddy.firstFreeBlock[order] = nextBlock;
+    
+    if(nextBlock != NO_SEGMENT)
+    buddy.previousFreeBlock[nextBlock] = previousBlock;
+    
+    if(buddy.firstFreeBlock[order] == NO_SEGMENT)
+    buddy.nonEmptyOrders &= ~(1ull << order);
+}
+
+// Block size given to a memory requirement: the smallest power of two that holds it, and at least the
+// minimum block. Requirements bigger than the biggest possible block get UINT64_MAX, which never fits.
+uint64_t buddyBlockSize(const CPU &processor, uint64_t memoryRequirement){
+    unsigned int order = processor.buddy.minimumOrder;
+    
+    if(memoryRequirement > (1ull << (BUDDY_ORDER_COUNT - 1)))
+    return UINT64_MAX;
+    
+    if(memoryRequirement > (1ull << order))
+    order = BUDDY_ORDER_COUNT - __builtin_clzll(memoryRequirement - 1);
+    
+    return 1ull << order;
+}
+
+// Splits the memory into the biggest aligned power of two blocks, from address 0 up (e.g. 2000 units
+// are 1024 + 512 + 256 + 128 + 64 + 16). A tail smaller than the minimum block is left as a hole that
+// is never used.
+void initializeBuddyMemory(CPU &processor, unsigned int minimumBlockSize){
+    BuddyAllocator &buddy = processor.buddy;
+    
+    buddy.minimumOrder = __builtin_ctz(minimumBlockSize);
+    buddy.nonEmptyOrders = 0;
+    for(int order = 0; order < BUDDY_ORDER_COUNT; order++)
+    buddy.firstFreeBlock[order] = NO_SEGMENT;
+    buddy.previousFreeBlock.clear();
+    buddy.nextFreeBlock.clear();
+    
+    //Buddy placement never looks holes up by size
+    processor.holeIndex = HOLE_INDEX_NONE;
+    processor.memoryHolesBySize.clear();
+    processor.maximumPlacementSize = 0;
+    
+    int blockSegment = processor.firstSegment;
+    uint64_t remainingMemory = processor.totalMemory;
+    
+    while(remainingMemory >= minimumBlockSize){
+        uint64_t blockSize = 1ull << (63 - __builtin_clzll(remainingMemory));
+        
+        if(blockSize < remainingMemory){
+            insertMemoryHoleAfterIndex(processor, blockSegment, remainingMemory - blockSize);
+            processor.segments.size[blockSegment] = blockSize;
+        }
+        
+        addFreeBuddyBlock(processor, blockSegment);
+        processor.maximumPlacementSize = max(processor.maximumPlacementSize, blockSize);
+        
+        remainingMemory -= blockSize;
+        blockSegment = processor.segments.nextSegment[blockSegment];
+    }
+}
+
+// Takes a free block of blockSize units, splitting the smallest bigger block available in halves.
+// Returns NO_SEGMENT if there is none.
+int findBuddyMemoryBlock(CPU &processor, uint64_t blockSize){
+    BuddyAllocator &buddy = processor.buddy;
+    
+    if(blockSize == UINT64_MAX)
+    return NO_SEGMENT;
+    
+    int order = __builtin_ctzll(blockSize);
+    uint64_t availableOrders = buddy.nonEmptyOrders & ~((1ull << order) - 1);
+    
+    if(availableOrders == 0)
+    return NO_SEGMENT;
+    
+    int blockOrder = __builtin_ctzll(availableOrders);
+    int blockSegment = buddy.firstFreeBlock[blockOrder];
+    removeFreeBuddyBlock(processor, blockSegment);
+    
+    //The upper halves are left free
+    while(blockOrder > order){
+        blockOrder--;
+        insertMemoryHoleAfterIndex(processor, blockSegment, 1ull << blockOrder);
+        processor.segments.size[blockSegment] = 1ull << blockOrder;
+        addFreeBuddyBlock(processor, processor.segments.nextSegment[blockSegment]);
+    }
+    
+    return blockSegment;
+}
+
+// Frees a block, merging it with its buddy as long as the buddy is free and not split
+void releaseBuddyMemoryBlock(CPU &processor, int blockSegment){
+    const SegmentTable &segments = processor.segments;
+    
+    while(true){
+        uint64_t blockSize = segments.size[blockSegment];
+        uint64_t buddyAddress = segments.startAddress[blockSegment] ^ blockSize;
+        int buddySegment = buddyAddress > segments.startAddress[blockSegment] ? segments.nextSegment[blockSegment] : segments.previousSegment[blockSegment];
+        
+        if(buddySegment == NO_SEGMENT || segments.state[buddySegment] != HOLE_SEGMENT
+        || segments.startAddress[buddySegment] != buddyAddress || segments.size[buddySegment] != blockSize)
+        break;
+        
+        removeFreeBuddyBlock(processor, buddySegment);
+        
+        if(buddyAddress > segments.startAddress[blockSegment])
+        absorbNextMemoryHole(processor, blockSegment);
+        else{
+            absorbNextMemoryHole(processor, buddySegment);
+            blockSegment = buddySegment;
+        }
+    }
+    
+    addFreeBuddyBlock(processor, blockSegment);
+}
+
+// Advances the processor clock. Only the processes that finish are visited (the ones at the top of the
+// completions heap): they become holes, which the placement policy merges with the adjacent ones.
+template <class PlacementPolicy>
+void decreaseProcessesTimeUnitsAndConvertFinishedIntoHoles(CPU &processor, Metrics &metrics, unsigned int elapsedTimeUnits = 1){
+    //While the processor compacts memory the processes do not advance
+    if(processor.stalledTimeUnits >= elapsedTimeUnits){
+        processor.stalledTimeUnits -= elapsedTimeUnits;
+        return;
+    }
+    elapsedTimeUnits -= processor.stalledTimeUnits;
+    processor.stalledTimeUnits = 0;
+    
+    processor.elapsedTimeUnits += elapsedTimeUnits;
+    
+    while(!processor.completions.empty() && processor.completions.top().first <= processor.elapsedTimeUnits){
+        int segment = processor.completions.top().second;
+        processor.completions.pop();
+        
+        processor.usedMemory -= processor.segments.size[segment];
+        processor.internalFragmentation -= processor.segments.size[segment] - processor.segments.requestedSize[segment];
+        processor.segments.state[segment] = HOLE_SEGMENT;
+        releaseProcessHandle(processor.processes, processor.segments.processId[segment]);
+        addMemoryHoleToIndex(processor, segment);
+        PlacementPolicy::releaseMemoryHole(processor, segment);
+        metrics.processesCompleted++;
+    }
+}
+
+bool shouldContinueSimulation(const ProcessQueue &queue, const CPU &processor){
+    
+    bool hasActiveProcesses = false;
+    
+    //Si la queue no tiene processes retenidos...
+    if(queue.length == 0){
+        
+        //Cuentas si te quedan processes vivos
+        hasActiveProcesses = !processor.completions.empty();
+    }    
+    
+    else{
+        //Cuentas si tienes cosas en queue
+        hasActiveProcesses = true;
+    }
+    
+    return hasActiveProcesses;
+}
+
+// Memory map dump. The output goes through a user-space buffer that is written when it fills up
+// (never per line), and can be limited to every Nth time instant or to the segments that changed.
+// Optionally a writer thread formats and writes it, fed through an OutputRing.
+struct SegmentSnapshot{
+    uint64_t startAddress;
+    uint64_t size;
+    uint32_t state;
+    uint32_t processId;
+    uint64_t finishTime; // Tells apart two processes with the same handle placed in the same segment
+};
+
+// Entries published by the simulation thread for the writer thread
+const uint32_t RING_TIME_INSTANT = 0; // values[0]: time. Followed by its segments and a RING_END_TIME_INSTANT
+const uint32_t RING_SEGMENT = 1;      // values[0..7]: start (low, high), size (low, high), state, process id, finish time (low, high)
+const uint32_t RING_END_TIME_INSTANT = 2;
+const uint32_t RING_PROCESS_NAME = 3; // values[0]: process handle, values[1]: name length, values[2]: offset, then up to 24 characters
+const size_t RING_NAME_CHARACTERS = 24;
+
+struct OutputRingEntry{
+    uint32_t type;
+    uint32_t values[9];
+};
+
+// Lock-free single producer / single consumer ring. Each position is written by one thread only:
+// writePosition by the simulation thread and readPosition by the writer thread.
+struct OutputRing{
+    vector<OutputRingEntry> entries; // Size is a power of two
+    size_t mask;
+    alignas(64) atomic<uint64_t> writePosition;
+    alignas(64) atomic<uint64_t> readPosition;
+    alignas(64) atomic<bool> finished;
+    uint64_t pendingWritePosition; // Simulation thread: entries written but not published yet
+    bool dropWhenFull;             // Backpressure: drop whole time instants instead of waiting for the writer
+    uint64_t droppedTimeInstants;
+    vector<uint32_t> publishedGenerations; // Generation of each handle whose name was sent to the writer thread, plus one
+    vector<Process> processes;     // Writer thread: its own copy of the process names, by handle
+    thread writerThread;
+};
+
+struct MemoryMapWriter{
+    int descriptor;
+    vector<char> buffer;
+    size_t usedBytes;
+    bool failed;
+    unsigned int sampleEvery;          // Write one of every sampleEvery time instants
+    unsigned long long offeredTimeInstants;
+    bool deltaOnly;                    // Write only the segments that changed since the last written time instant
+    vector<SegmentSnapshot> previousSegments, currentSegments;
+    OutputRing *ring;                  // Not NULL when a writer thread formats and writes the dump
+    uint64_t appendedBytes;            // Since the file was opened, flushed or not
+    bool binaryHistory;                // Write the binary history instead of text
+    uint32_t keyframeEvery;
+    uint64_t historyRecords;
+    int previousHistoryTime;
+    vector<unsigned char> historyEvents; // Events of the record being encoded
+    vector<HistoryIndexEntry> historyIndex;
+    uint64_t granularity;              // Addresses and sizes are written in memory units, not granules
+};
+
+void flushMemoryMapWriter(MemoryMapWriter &writer){
+    size_t writtenBytes = 0;
+    
+    while(writtenBytes < writer.usedBytes && !writer.failed){
+        ssize_t result = write(writer.descriptor, &writer.buffer[writtenBytes], writer.usedBytes - writtenBytes);
+        
+        if(result > 0)
+        writtenBytes += result;
+        else if(result == -1 && errno != EINTR)
+        writer.failed = true;
+    }
+    
+    writer.usedBytes = 0;
+}
+
+void appendToMemoryMapWriter(MemoryMapWriter &writer, const char *text, size_t length){
+    writer.appendedBytes += length;
+    
+    if(writer.usedBytes + length > writer.buffer.size()){
+        flushMemoryMapWriter(writer);
+        
+        //Texts bigger than the whole buffer go straight to the file
+        if(length > writer.buffer.size()){
+            writer.usedBytes = length;
+            writer.buffer.resize(length);
+            memcpy(&writer.buffer[0], text, length);
+            flushMemoryMapWriter(writer);
+            return;
+        }
+    }
+    
+    memcpy(&writer.buffer[writer.usedBytes], text, length);
+    writer.usedBytes += length;
+}
+
+void appendUnsignedToMemoryMapWriter(MemoryMapWriter &writer, unsigned long long value){
+    char digits[20];
+    int position = sizeof(digits);
+    
+    do{
+        digits[--position] = '0' + value % 10;
+        value /= 10;
+    }while(value != 0);
+    
+    appendToMemoryMapWriter(writer, digits + position, sizeof(digits) - position);
+}
+
+void appendHistoryVarint(vector<unsigned char> &bytes, uint64_t value){
+    unsigned char encoded[10];
+    bytes.insert(bytes.end(), encoded, encoded + encodeHistoryVarint(value, encoded));
+}
+
+// "[start name size] "
+void appendSegmentToMemoryMapWriter(MemoryMapWriter &writer, const SegmentSnapshot &segment, const vector<Process> &processes){
+    static const string holeName = "hole";
+    const string &name = segment.state == HOLE_SEGMENT ? holeName : processes[segment.processId].name;
+    
+    appendToMemoryMapWriter(writer, "[", 1);
+    appendUnsignedToMemoryMapWriter(writer, segment.startAddress * writer.granularity);
+    appendToMemoryMapWriter(writer, " ", 1);
+    appendToMemoryMapWriter(writer, name.data(), name.size());
+    appendToMemoryMapWriter(writer, " ", 1);
+    appendUnsignedToMemoryMapWriter(writer, segment.size * writer.granularity);
+    appendToMemoryMapWriter(writer, "] ", 2);
+}
+
+bool isSameSegment(const SegmentSnapshot &first, const SegmentSnapshot &second){
+    return first.startAddress == second.startAddress && first.size == second.size && first.state == second.state
+    && first.processId == second.processId && first.finishTime == second.finishTime;
+}
+
+// Copies the memory map, in address order, into segments
+void captureMemoryMapSnapshot(const CPU &processor, vector<SegmentSnapshot> &segments){
+    segments.clear();
+    
+    for(int segment = processor.firstSegment; segment != NO_SEGMENT; segment = processor.segments.nextSegment[segment]){
+        SegmentSnapshot snapshot;
+        snapshot.startAddress = processor.segments.startAddress[segment];
+        snapshot.size = processor.segments.size[segment];
+        snapshot.state = processor.segments.state[segment];
+        snapshot.processId = snapshot.state == HOLE_SEGMENT ? 0 : processor.segments.processId[segment];
+        snapshot.finishTime = snapshot.state == HOLE_SEGMENT ? 0 : processor.segments.finishTime[segment];
+        segments.push_back(snapshot);
+    }
+}
+
+// Why segment is not in the previous record. previousPosition is the first previous segment that ends
+// after the start of segment.
+uint32_t historyEventKind(const vector<SegmentSnapshot> &previousSegments, size_t previousPosition, const SegmentSnapshot &segment){
+    if(segment.state != HOLE_SEGMENT)
+    return HISTORY_ASSIGN;
+    
+    if(previousPosition == previousSegments.size())
+    return HISTORY_MERGE;
+    
+    const SegmentSnapshot &previous = previousSegments[previousPosition];
+    
+    if(previous.startAddress + previous.size < segment.startAddress + segment.size)
+    return HISTORY_MERGE;
+    
+    if(previous.startAddress == segment.startAddress && previous.size == segment.size)
+    return HISTORY_FREE;
+    
+    return HISTORY_SPLIT;
+}
+
+// Adds a record of writer.currentSegments to the binary history: every segment in a keyframe, only the
+// ones that changed since the previous record otherwise. In delta mode records without changes are
+// left out, as in the text dump.
+void encodeHistoryTimeInstant(MemoryMapWriter &writer, int currentTime, const vector<Process> &processes){
+    const vector<SegmentSnapshot> &segments = writer.currentSegments;
+    const vector<SegmentSnapshot> &previousSegments = writer.previousSegments;
+    vector<unsigned char> &events = writer.historyEvents;
+    bool isKeyframe = writer.historyRecords % writer.keyframeEvery == 0;
+    size_t previousPosition = 0, eventCount = 0;
+    uint64_t eventsEnd = 0; // Granules, as the segments; the events are written in memory units
+    bool hasChanges = false;
+    
+    events.clear();
+    for(size_t i = 0; i < segments.size(); i++){
+        while(previousPosition < previousSegments.size() && previousSegments[previousPosition].startAddress + previousSegments[previousPosition].size <= segments[i].startAddress)
+        previousPosition++;
+        
+        bool isChanged = previousPosition == previousSegments.size() || !isSameSegment(previousSegments[previousPosition], segments[i]);
+        hasChanges = hasChanges || isChanged;
+        
+        if(!isKeyframe && !isChanged)
+        continue;
+        
+        //A keyframe only tells processes from holes
+        uint32_t kind = isKeyframe ? (segments[i].state == HOLE_SEGMENT ? HISTORY_FREE : HISTORY_ASSIGN) : historyEventKind(previousSegments, previousPosition, segments[i]);
+        
+        appendHistoryVarint(events, ((segments[i].startAddress - eventsEnd) * writer.granularity << HISTORY_EVENT_KIND_BITS) | kind);
+        appendHistoryVarint(events, segments[i].size * writer.granularity);
+        
+        if(kind == HISTORY_ASSIGN){
+            const string &name = processes[segments[i].processId].name;
+            appendHistoryVarint(events, name.size());
+            events.insert(events.end(), name.begin(), name.end());
+        }
+        
+        eventsEnd = segments[i].startAddress + segments[i].size;
+        eventCount++;
+    }
+    writer.previousSegments.swap(writer.currentSegments);
+    
+    if(!hasChanges && writer.deltaOnly)
+    return;
+    
+    if(isKeyframe){
+        HistoryIndexEntry entry = {(uint64_t)currentTime, writer.appendedBytes};
+        writer.historyIndex.push_back(entry);
+    }
+    
+    //Record header, then the events
+    unsigned char header[21];
+    size_t headerLength = 0;
+    header[headerLength++] = isKeyframe ? HISTORY_KEYFRAME : HISTORY_DELTA;
+    headerLength += encodeHistoryVarint(isKeyframe ? currentTime : currentTime - writer.previousHistoryTime, header + headerLength);
+    headerLength += encodeHistoryVarint(eventCount, header + headerLength);
+    
+    appendToMemoryMapWriter(writer, (const char *)header, headerLength);
+    if(!events.empty())
+    appendToMemoryMapWriter(writer, (const char *)&events[0], events.size());
+    
+    writer.previousHistoryTime = currentTime;
+    writer.historyRecords++;
+}
+
+// Formats writer.currentSegments as "time [start name size] [start name size] ...".
+// In delta mode only the segments that are new since the last written line are listed (they cover
+// every removed segment), and time instants without changes are not written at all.
+void formatMemoryMapTimeInstant(MemoryMapWriter &writer, int currentTime, const vector<Process> &processes){
+    const vector<SegmentSnapshot> &segments = writer.currentSegments;
+    
+    if(writer.binaryHistory){
+        encodeHistoryTimeInstant(writer, currentTime, processes);
+        return;
+    }
+    
+    if(!writer.deltaOnly){
+        appendUnsignedToMemoryMapWriter(writer, currentTime);
+        appendToMemoryMapWriter(writer, " ", 1);
+        
+        for(size_t i = 0; i < segments.size(); i++)
+        appendSegmentToMemoryMapWriter(writer, segments[i], processes);
+        
+        appendToMemoryMapWriter(writer, "\n", 1);
+        return;
+    }
+    
+    //Both snapshots are in address order, so they are compared walking them side by side
+    size_t previousPosition = 0;
+    bool hasChanges = false;
+    
+    for(size_t i = 0; i < segments.size(); i++){
+        while(previousPosition < writer.previousSegments.size() && writer.previousSegments[previousPosition].startAddress < segments[i].startAddress)
+        previousPosition++;
+        
+        if(previousPosition < writer.previousSegments.size() && isSameSegment(writer.previousSegments[previousPosition], segments[i]))
+        continue;
+        
+        if(!hasChanges){
+            appendUnsignedToMemoryMapWriter(writer, currentTime);
+            appendToMemoryMapWriter(writer, " ", 1);
+            hasChanges = true;
+        }
+        appendSegmentToMemoryMapWriter(writer, segments[i], processes);
+    }
+    
+    if(hasChanges)
+    appendToMemoryMapWriter(writer, "\n", 1);
+    
+    writer.previousSegments.swap(writer.currentSegments);
+}
+
+// Writer thread: rebuilds every published time instant and formats it
+void runMemoryMapWriterThread(MemoryMapWriter *writer){
+    OutputRing &ring = *writer->ring;
+    uint64_t readPosition = ring.readPosition.load(memory_order_relaxed);
+    int snapshotTime = 0;
+    
+    while(true){
+        uint64_t writePosition = ring.writePosition.load(memory_order_acquire);
+        
+        if(readPosition == writePosition){
+            //Nothing pending: stop only once the simulation has published everything
+            if(ring.finished.load(memory_order_acquire) && readPosition == ring.writePosition.load(memory_order_acquire))
+            break;
+            
+            this_thread::yield();
+            continue;
+        }
+        
+        for(; readPosition != writePosition; readPosition++){
+            const OutputRingEntry &entry = ring.entries[readPosition & ring.mask];
+            
+            if(entry.type == RING_TIME_INSTANT){
+                snapshotTime = (int)entry.values[0];
+                writer->currentSegments.clear();
+            }
+            else if(entry.type == RING_SEGMENT){
+                SegmentSnapshot segment;
+                segment.startAddress = ((uint64_t)entry.values[1] << 32) | entry.values[0];
+                segment.size = ((uint64_t)entry.values[3] << 32) | entry.values[2];
+                segment.state = entry.values[4];
+                segment.processId = entry.values[5];
+                segment.finishTime = ((uint64_t)entry.values[7] << 32) | entry.values[6];
+                writer->currentSegments.push_back(segment);
+            }
+            else if(entry.type == RING_END_TIME_INSTANT)
+            formatMemoryMapTimeInstant(*writer, snapshotTime, ring.processes);
+            
+            else if(entry.type == RING_PROCESS_NAME){
+                if(entry.values[0] >= ring.processes.size())
+                ring.processes.resize(entry.values[0] + 1);
+                
+                //The handle may have belonged to another process: its first part replaces the old name
+                string &name = ring.processes[entry.values[0]].name;
+                if(entry.values[2] == 0)
+                name.clear();
+                
+                size_t characters = min((size_t)(entry.values[1] - entry.values[2]), RING_NAME_CHARACTERS);
+                name.append((const char *)&entry.values[3], characters);
+            }
+        }
+        
+        ring.readPosition.store(readPosition, memory_order_release);
+    }
+}
+
+bool openMemoryMapWriter(const string &exportFileName, const SimulationOptions &options, MemoryMapWriter &writer){
+    writer.descriptor = open(exportFileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    writer.buffer.resize(options.outputBufferSize);
+    writer.usedBytes = 0;
+    writer.failed = false;
+    writer.sampleEvery = options.outputSampleEvery;
+    writer.offeredTimeInstants = 0;
+    writer.deltaOnly = options.outputDeltaOnly;
+    writer.previousSegments.clear();
+    writer.currentSegments.clear();
+    writer.ring = NULL;
+    writer.appendedBytes = 0;
+    writer.binaryHistory = options.outputBinaryHistory;
+    writer.keyframeEvery = options.historyKeyframeEvery;
+    writer.granularity = options.granularity;
+    writer.historyRecords = 0;
+    writer.previousHistoryTime = 0;
+    writer.historyEvents.clear();
+    writer.historyIndex.clear();
+    
+    if(writer.descriptor == -1)
+    return false;
+    
+    if(writer.binaryHistory){
+        HistoryHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, HISTORY_MAGIC, sizeof(header.magic));
+        header.keyframeEvery = writer.keyframeEvery;
+        appendToMemoryMapWriter(writer, (const char *)&header, sizeof(header));
+    }
+    
+    if(options.asyncOutput){
+        size_t capacity = 1;
+        while(capacity < options.asyncRingEntries)
+        capacity *= 2;
+        
+        writer.ring = new OutputRing;
+        writer.ring->entries.resize(capacity);
+        writer.ring->mask = capacity - 1;
+        writer.ring->writePosition.store(0);
+        writer.ring->readPosition.store(0);
+        writer.ring->finished.store(false);
+        writer.ring->pendingWritePosition = 0;
+        writer.ring->dropWhenFull = options.asyncDropWhenFull;
+        writer.ring->droppedTimeInstants = 0;
+        writer.ring->writerThread = thread(runMemoryMapWriterThread, &writer);
+    }
+    
+    return true;
+}
+
+void closeMemoryMapWriter(MemoryMapWriter &writer){
+    if(writer.ring != NULL){
+        writer.ring->finished.store(true, memory_order_release);
+        writer.ring->writerThread.join();
+        
+        if(writer.ring->droppedTimeInstants > 0)
+        cout << "Warning: " << writer.ring->droppedTimeInstants << " time instants were not written because the output writer was full" << endl;
+        
+        delete writer.ring;
+        writer.ring = NULL;
+    }
+    
+    //The index of the keyframes goes after the last record
+    if(writer.binaryHistory){
+        HistoryFooter footer;
+        memset(&footer, 0, sizeof(footer));
+        footer.indexOffset = writer.appendedBytes;
+        footer.keyframeCount = writer.historyIndex.size();
+        footer.recordCount = writer.historyRecords;
+        memcpy(footer.magic, HISTORY_INDEX_MAGIC, sizeof(footer.magic));
+        
+        if(!writer.historyIndex.empty())
+        appendToMemoryMapWriter(writer, (const char *)&writer.historyIndex[0], writer.historyIndex.size() * sizeof(HistoryIndexEntry));
+        appendToMemoryMapWriter(writer, (const char *)&footer, sizeof(footer));
+    }
+    
+    flushMemoryMapWriter(writer);
+    close(writer.descriptor);
+    
+    if(writer.failed)
+    cout << "Error: The output file could not be completely written" << endl;
+}
+
+// Simulation thread: appends an entry to the ring, waiting for the writer thread while it is full.
+// The entry is visible to the writer thread once the pending entries are published.
+void pushOutputRingEntry(OutputRing &ring, const OutputRingEntry &entry){
+    if(ring.pendingWritePosition - ring.readPosition.load(memory_order_acquire) == ring.entries.size()){
+        //Let the writer drain what is already written
+        ring.writePosition.store(ring.pendingWritePosition, memory_order_release);
+        
+        while(ring.pendingWritePosition - ring.readPosition.load(memory_order_acquire) == ring.entries.size())
+        this_thread::yield();
+    }
+    
+    ring.entries[ring.pendingWritePosition & ring.mask] = entry;
+    ring.pendingWritePosition++;
+}
+
+void publishMemoryMapTimeInstant(OutputRing &ring, const CPU &processor, int currentTime){
+    OutputRingEntry entry;
+    memset(&entry, 0, sizeof(entry));
+    
+    //Names of the processes placed since their handle was last published, split in parts of RING_NAME_CHARACTERS
+    const ProcessTable &table = processor.processes;
+    size_t namesEntries = 0;
+    
+    if(ring.publishedGenerations.size() < table.processes.size())
+    ring.publishedGenerations.resize(table.processes.size(), 0);
+    
+    for(int segment = processor.firstSegment; segment != NO_SEGMENT; segment = processor.segments.nextSegment[segment]){
+        uint32_t handle = processor.segments.processId[segment];
+        
+        if(processor.segments.state[segment] != HOLE_SEGMENT && ring.publishedGenerations[handle] != table.generations[handle] + 1)
+        namesEntries += table.processes[handle].name.size() / RING_NAME_CHARACTERS + 1;
+    }
+    
+    //Dropping is only possible before anything of the time instant is written
+    if(ring.dropWhenFull){
+        size_t segmentCount = processor.segments.size.size() - processor.unusedSegments.size();
+        size_t freeEntries = ring.entries.size() - (ring.pendingWritePosition - ring.readPosition.load(memory_order_acquire));
+        
+        if(namesEntries + segmentCount + 2 > freeEntries){
+            ring.droppedTimeInstants++;
+            return;
+        }
+    }
+    
+    for(int segment = processor.firstSegment; segment != NO_SEGMENT && namesEntries > 0; segment = processor.segments.nextSegment[segment]){
+        uint32_t handle = processor.segments.processId[segment];
+        
+        if(processor.segments.state[segment] == HOLE_SEGMENT || ring.publishedGenerations[handle] == table.generations[handle] + 1)
+        continue;
+        
+        const string &name = table.processes[handle].name;
+        size_t offset = 0;
+        ring.publishedGenerations[handle] = table.generations[handle] + 1;
+        
+        do{
+            size_t characters = min(name.size() - offset, RING_NAME_CHARACTERS);
+            entry.type = RING_PROCESS_NAME;
+            entry.values[0] = handle;
+            entry.values[1] = name.size();
+            entry.values[2] = offset;
+            memcpy(&entry.values[3], name.data() + offset, characters);
+            pushOutputRingEntry(ring, entry);
+            offset += characters;
+        }while(offset < name.size());
+    }
+    
+    memset(&entry, 0, sizeof(entry));
+    entry.type = RING_TIME_INSTANT;
+    entry.values[0] = currentTime;
+    pushOutputRingEntry(ring, entry);
+    
+    entry.type = RING_SEGMENT;
+    for(int segment = processor.firstSegment; segment != NO_SEGMENT; segment = processor.segments.nextSegment[segment]){
+        bool isHole = processor.segments.state[segment] == HOLE_SEGMENT;
+        uint64_t startAddress = processor.segments.startAddress[segment];
+        uint64_t size = processor.segments.size[segment];
+        uint64_t finishTime = isHole ? 0 : processor.segments.finishTime[segment];
+        
+        entry.values[0] = (uint32_t)startAddress;
+        entry.values[1] = (uint32_t)(startAddress >> 32);
+        entry.values[2] = (uint32_t)size;
+        entry.values[3] = (uint32_t)(size >> 32);
+        entry.values[4] = processor.segments.state[segment];
+        entry.values[5] = isHole ? 0 : processor.segments.processId[segment];
+        entry.values[6] = (uint32_t)finishTime;
+        entry.values[7] = (uint32_t)(finishTime >> 32);
+        pushOutputRingEntry(ring, entry);
+    }
+    
+    memset(&entry, 0, sizeof(entry));
+    entry.type = RING_END_TIME_INSTANT;
+    pushOutputRingEntry(ring, entry);
+    
+    ring.writePosition.store(ring.pendingWritePosition, memory_order_release);
+}
+
+// Dumps the memory map at currentTime, either formatting it right away or handing it to the writer thread
+void writeMemoryMapTimeInstant(MemoryMapWriter &writer, const CPU &processor, int currentTime){
+    writer.offeredTimeInstants++;
+    if((writer.offeredTimeInstants - 1) % writer.sampleEvery != 0)
+    return;
+    
+    if(writer.ring != NULL){
+        publishMemoryMapTimeInstant(*writer.ring, processor, currentTime);
+        return;
+    }
+    
+    captureMemoryMapSnapshot(processor, writer.currentSegments);
+    formatMemoryMapTimeInstant(writer, currentTime, processor.processes.processes);
+}
+
+// Number of upcoming time units (after currentTime) in which nothing can happen: no process arrives,
+// no process finishes and the queue cannot change. Returns 0 when the next time unit has an event.
+template <class PlacementPolicy>
+int countIdleTimeUnitsUntilNextEvent(const ArrivalStream &arrivals, const CPU &processor, int currentTime, int completedBefore, const Metrics &metrics, const SimulationOptions &options, int stopTime){
+    const ProcessQueue &queue = processor.queue;
+    
+    //Processes finished in this time unit free memory, so the queue must be retried right away
+    if(metrics.processesCompleted != completedBefore)
+    return 0;
+    
+    //An oversized process is discarded in the next time unit: only at the head of a FIFO queue, anywhere in the rest
+    if(queue.length != 0 && options.queuePolicy == FIFO_QUEUE && requiredGranules(processor, queuedProcess(processor, queue.head).memoryRequirement) > processor.maximumPlacementSize)
+    return 0;
+    
+    if(queue.length != 0 && options.queuePolicy != FIFO_QUEUE && requiredGranules(processor, queue.processesBySize.rbegin()->first) > processor.maximumPlacementSize)
+    return 0;
+    
+    //A placement after the retry of the queue may leave a queued process a hole that it did not have then
+    if(queue.length != 0 && PlacementPolicy::fitsDependOnListOrder && processor.hasPlacedSinceQueueRetry)
+    return 0;
+    
+    //Arrivals are placed without compacting, so the process the queue picks in the next time unit may be placed
+    //by compacting memory then: it fits in no hole, but it may fit in all of them together
+    if(queue.length != 0 && PlacementPolicy::supportsCompaction && options.compaction != NO_COMPACTION){
+        uint64_t sequence = queue.head;
+        
+        if(options.queuePolicy == SMALLEST_FIRST_QUEUE
+        || (options.queuePolicy == AGING_QUEUE && currentTime + 1 - (long long)queuedProcess(processor, queue.head).arrivalTime < options.queueAgingLimit))
+        sequence = smallestQueuedProcess(queue);
+        
+        if(requiredGranules(processor, queuedProcess(processor, sequence).memoryRequirement) <= processor.totalMemory - processor.usedMemory)
+        return 0;
+    }
+    
+    long long nextEventTime = -1;
+    
+    if(hasPendingArrivals(arrivals))
+    nextEventTime = nextArrival(arrivals).arrivalTime;
+    
+    //A process with r remaining time units finishes at the end of currentTime + r, after any compaction
+    if(!processor.completions.empty()){
+        long long completionTime = (long long)currentTime + processor.stalledTimeUnits + (processor.completions.top().first - processor.elapsedTimeUnits) + 1;
+        if(nextEventTime == -1 || completionTime < nextEventTime)
+        nextEventTime = completionTime;
+    }
+    
+    //A simulation run in steps stops at stopTime, even without any event there
+    if(nextEventTime == -1 || nextEventTime > stopTime)
+    nextEventTime = stopTime;
+    
+    if(nextEventTime <= currentTime + 1)
+    return 0;
+    
+    return (int)(nextEventTime - currentTime - 1);
+}
+
+// Event-driven mode: skips the idle time units that follow currentTime (up to stopTime), accounting for
+// them in the metrics and in the remaining time of the running processes. Returns the last skipped time unit.
+template <class PlacementPolicy>
+int skipIdleTimeUnits(const ArrivalStream &arrivals, CPU &processor, Metrics &metrics, int currentTime, int completedBefore, const SimulationOptions &options, int stopTime){
+    int idleTimeUnits = countIdleTimeUnitsUntilNextEvent<PlacementPolicy>(arrivals, processor, currentTime, completedBefore, metrics, options, stopTime);
+    
+    if(idleTimeUnits > 0){
+        updateMetricsForIdleTimeUnits(metrics, processor, currentTime + 1, idleTimeUnits);
+        decreaseProcessesTimeUnitsAndConvertFinishedIntoHoles<PlacementPolicy>(processor, metrics, idleTimeUnits);
+        currentTime += idleTimeUnits;
+        metrics.totalSimulationTime = currentTime;
+    }
+    
+    return currentTime;
+}
+
+// Checkpoints: the state of a simulation at the start of a time unit, from which it is resumed, or
+// branched into other algorithms and memory sizes (what-if mode). Only what cannot be derived is saved:
+// the memory map, the queue, the names of the resident processes, the metrics and the position of the
+// next arrival. Hole indexes, buddy free lists and pending completions are rebuilt on restore, so the
+// size of a checkpoint depends on the memory map and the queue, not on the length of the trace.
+// A checkpoint is only read back by the build that wrote it.
+const char CHECKPOINT_MAGIC[8] = {'M', 'M', 'C', 'K', 'P', 'T', '0', '3'};
+const uint64_t NO_TRACE_OFFSET = UINT64_MAX;
+
+struct CheckpointHeader{
+    char magic[8];
+    uint32_t metricsSize;          // sizeof(Metrics) of the build that wrote it
+    int32_t algorithm;
+    uint64_t totalMemory;
+    uint64_t maximumPlacementSize;
+    uint32_t buddyMinimumBlockSize;
+    uint64_t processMemoryEnd;     // End address of the last process segment
+    uint64_t granularity;          // Memory units per granule, which every address and size above is in
+    int32_t resumeTime;            // First time unit simulated after restoring
+    uint64_t traceSize;            // Bytes of the trace, to catch a different trace
+    uint64_t totalProcesses;
+    uint64_t consumedArrivals;     // Arrivals already taken, in arrival time order
+    uint64_t traceOffset;          // Sorted traces: where the chunk of the next arrival starts, NO_TRACE_OFFSET otherwise
+    uint64_t traceLineNumber;      // Reader state at traceOffset
+    uint64_t traceRemainingRecords;
+    uint64_t chunkPosition;        // Arrivals of that chunk already taken
+    uint64_t elapsedTimeUnits;
+    uint64_t stalledTimeUnits;
+    uint32_t segmentCount;         // Positions of the segment table
+    int32_t firstSegment;
+    int32_t nextFitSegment;
+    uint32_t unusedSegmentCount;
+    uint32_t processNameCount;     // Names of the resident processes, which get new process ids
+    uint32_t queueLength;
+    uint32_t freeListHoleCount;    // Buddy and TLSF: the holes of their free lists, in the order they are taken
+};
+// Followed by the Metrics, the segment table arrays, the unused positions, the free list holes, the process
+// names (length and characters) and the queued processes in arrival order (name length, arrival time, execution and
+// remaining time units, the 64-bit memory requirement and the name characters)
+
+struct CheckpointReader{
+    const char *cursor;
+    const char *end;
+    bool isValid; // Cleared when the checkpoint ends too soon
+};
+
+template <class T>
+void writeCheckpointValues(ostream &checkpoint, const T *values, size_t count){
+    if(count != 0)
+    checkpoint.write((const char *)values, count * sizeof(T));
+}
+
+template <class T>
+void readCheckpointValues(CheckpointReader &reader, T *values, size_t count){
+    size_t bytes = count * sizeof(T);
+    
+    if(!reader.isValid || (size_t)(reader.end - reader.cursor) < bytes){
+        reader.isValid = false;
+        return;
+    }
+    
+    if(bytes != 0)
+    memcpy(values, reader.cursor, bytes);
+    reader.cursor += bytes;
+}
+
+void readCheckpointString(CheckpointReader &reader, uint32_t length, string &text){
+    if(!reader.isValid || (size_t)(reader.end - reader.cursor) < length){
+        reader.isValid = false;
+        text.clear();
+        return;
+    }
+    
+    text.assign(reader.cursor, length);
+    reader.cursor += length;
+}
+
+string checkpointFileName(const string &prefix, int currentTime){
+    return prefix + "-" + to_string(currentTime) + ".ckpt";
+}
+
+// Saves the state at the start of resumeTime. Returns false (after reporting it) if it cannot be written.
+bool writeCheckpoint(const string &fileName, int algorithm, int resumeTime, const ArrivalStream &arrivals, const CPU &processor, const Metrics &metrics, const SimulationOptions &options){
+    const SegmentTable &segments = processor.segments;
+    CheckpointHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(header.magic));
+    
+    header.metricsSize = sizeof(Metrics);
+    header.algorithm = algorithm;
+    header.totalMemory = processor.totalMemory;
+    header.maximumPlacementSize = processor.maximumPlacementSize;
+    header.buddyMinimumBlockSize = options.buddyMinimumBlockSize;
+    header.granularity = processor.granularity;
+    header.resumeTime = resumeTime;
+    header.traceSize = arrivals.traceSize;
+    header.totalProcesses = arrivals.totalProcesses;
+    header.consumedArrivals = arrivals.consumedArrivals;
+    header.traceOffset = NO_TRACE_OFFSET;
+    
+    //A sorted trace is read again from the start of the current chunk, skipping what was taken from it
+    if(arrivals.source == ARRIVALS_FROM_TRACE){
+        header.traceOffset = arrivals.chunkStart - arrivals.trace.file.data;
+        header.traceLineNumber = arrivals.chunkStartLineNumber;
+        header.traceRemainingRecords = arrivals.chunkStartRemainingRecords;
+        header.chunkPosition = arrivals.chunkPosition;
+    }
+    
+    header.elapsedTimeUnits = processor.elapsedTimeUnits;
+    header.stalledTimeUnits = processor.stalledTimeUnits;
+    header.segmentCount = segments.size.size();
+    header.firstSegment = processor.firstSegment;
+    header.nextFitSegment = processor.nextFitSegment;
+    header.unusedSegmentCount = processor.unusedSegments.size();
+    header.queueLength = processor.queue.length;
+    
+    //Only the names of the resident processes are kept, one per process in address order
+    vector<uint32_t> processIds(segments.processId);
+    vector<const string *> processNames;
+    
+    for(int segment = processor.firstSegment; segment != NO_SEGMENT; segment = segments.nextSegment[segment]){
+        if(segments.state[segment] != PROCESS_SEGMENT)
+        continue;
+        
+        header.processMemoryEnd = segments.startAddress[segment] + segments.size[segment];
+        processIds[segment] = processNames.size();
+        processNames.push_back(&processor.processes.processes[segments.processId[segment]].name);
+    }
+    header.processNameCount = processNames.size();
+    
+    //Holes of the same size class are taken from the front of their list, so its order is kept
+    vector<int> freeListHoles;
+    
+    if(algorithm == BUDDY_ALGORITHM){
+        for(int order = 0; order < BUDDY_ORDER_COUNT; order++){
+            for(int block = processor.buddy.firstFreeBlock[order]; block != NO_SEGMENT; block = processor.buddy.nextFreeBlock[block])
+            freeListHoles.push_back(block);
+        }
+    }
+    else if(algorithm == TLSF_ALGORITHM){
+        for(int firstLevel = 0; firstLevel < TLSF_FIRST_LEVEL_COUNT; firstLevel++){
+            for(int secondLevel = 0; secondLevel < TLSF_SECOND_LEVEL_COUNT; secondLevel++){
+                for(int hole = processor.segregatedFit.firstFreeHole[firstLevel][secondLevel]; hole != NO_SEGMENT; hole = processor.segregatedFit.nextFreeHole[hole])
+                freeListHoles.push_back(hole);
+            }
+        }
+    }
+    header.freeListHoleCount = freeListHoles.size();
+    
+    ofstream checkpoint(fileName.c_str(), ios::binary);
+    
+    writeCheckpointValues(checkpoint, &header, 1);
+    writeCheckpointValues(checkpoint, &metrics, 1);
+    writeCheckpointValues(checkpoint, segments.startAddress.data(), header.segmentCount);
+    writeCheckpointValues(checkpoint, segments.size.data(), header.segmentCount);
+    writeCheckpointValues(checkpoint, segments.state.data(), header.segmentCount);
+    writeCheckpointValues(checkpoint, processIds.data(), header.segmentCount);
+    writeCheckpointValues(checkpoint, segments.finishTime.data(), header.segmentCount);
+    writeCheckpointValues(checkpoint, segments.requestedSize.data(), header.segmentCount);
+    writeCheckpointValues(checkpoint, segments.previousSegment.data(), header.segmentCount);
+    writeCheckpointValues(checkpoint, segments.nextSegment.data(), header.segmentCount);
+    writeCheckpointValues(checkpoint, processor.unusedSegments.data(), header.unusedSegmentCount);
+    writeCheckpointValues(checkpoint, freeListHoles.data(), header.freeListHoleCount);
+    
+    for(size_t name = 0; name < processNames.size(); name++){
+        uint32_t nameLength = processNames[name]->size();
+        writeCheckpointValues(checkpoint, &nameLength, 1);
+        writeCheckpointValues(checkpoint, processNames[name]->data(), nameLength);
+    }
+    
+    const ProcessQueue &queue = processor.queue;
+    for(uint64_t sequence = queue.head; sequence != queue.tail; sequence++){
+        if(!queue.isWaiting[sequence & (queue.slots.size() - 1)])
+        continue;
+        
+        const Process &process = queuedProcess(processor, sequence);
+        uint32_t fields[4] = {(uint32_t)process.name.size(), process.arrivalTime, process.executionTimeUnits, process.remainingTimeUnits};
+        writeCheckpointValues(checkpoint, fields, 4);
+        writeCheckpointValues(checkpoint, &process.memoryRequirement, 1);
+        writeCheckpointValues(checkpoint, process.name.data(), process.name.size());
+    }
+    
+    checkpoint.close();
+    if(!checkpoint){
+        cout << "Error: the checkpoint '" << fileName << "' could not be written." << endl;
+        return false;
+    }
+    
+    return true;
+}
+
+// Maps a checkpoint and checks that this build can read it. Returns false (after reporting it) otherwise.
+bool openCheckpoint(const string &fileName, MappedFile &checkpoint, CheckpointHeader &header){
+    if(!mapFile(fileName, checkpoint)){
+        cout << "Error: the checkpoint '" << fileName << "' was not found or could not be opened." << endl;
+        return false;
+    }
+    
+    if(checkpoint.size < sizeof(header) || memcmp(checkpoint.data, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0){
+        cout << "Error: '" << fileName << "' is not a checkpoint." << endl;
+        unmapFile(checkpoint);
+        return false;
+    }
+    
+    memcpy(&header, checkpoint.data, sizeof(header));
+    if(header.metricsSize != sizeof(Metrics) || header.algorithm < 0 || header.algorithm >= ALGORITHM_COUNT){
+        cout << "Error: the checkpoint '" << fileName << "' was written by a different build." << endl;
+        unmapFile(checkpoint);
+        return false;
+    }
+    
+    return true;
+}
+
+// Whether a checkpoint can go on with the algorithm and memory size given. Variable size partitions can
+// be exchanged, and resized as long as the resident processes still fit; a buddy memory map only goes on
+// as the same buddy system. Reports it when not.
+bool canBranchCheckpoint(const CheckpointHeader &header, int algorithm, uint64_t totalMemory, const SimulationOptions &options){
+    if((header.algorithm == BUDDY_ALGORITHM) != (algorithm == BUDDY_ALGORITHM)){
+        cout << "Error: a " << ALGORITHM_DESCRIPTIONS[header.algorithm] << " checkpoint cannot go on with the " << ALGORITHM_DESCRIPTIONS[algorithm] << " algorithm." << endl;
+        return false;
+    }
+    
+    //Addresses are kept in granules, so they only mean the same with the same granularity
+    if(options.granularity != header.granularity){
+        cout << "Error: the checkpoint only goes on with its granularity (" << header.granularity << ")." << endl;
+        return false;
+    }
+    
+    if(algorithm == BUDDY_ALGORITHM && (totalMemory != header.totalMemory || options.buddyMinimumBlockSize != header.buddyMinimumBlockSize)){
+        cout << "Error: a buddy system checkpoint only goes on with its memory size (" << header.totalMemory * header.granularity << ") and minimum block (" << header.buddyMinimumBlockSize << ")." << endl;
+        return false;
+    }
+    
+    if(totalMemory < header.processMemoryEnd){
+        cout << "Error: the processes of the checkpoint take memory up to " << header.processMemoryEnd * header.granularity << ", more than " << totalMemory * header.granularity << " units." << endl;
+        return false;
+    }
+    
+    return true;
+}
+
+// Changes the size of a restored memory map: the hole after the last process grows or shrinks, or a
+// hole is added after it
+void resizeRestoredMemory(CPU &processor, uint64_t totalMemory, int lastSegment){
+    SegmentTable &segments = processor.segments;
+    uint64_t lastEnd = segments.startAddress[lastSegment] + segments.size[lastSegment];
+    
+    if(segments.state[lastSegment] == HOLE_SEGMENT && totalMemory > segments.startAddress[lastSegment])
+    segments.size[lastSegment] = totalMemory - segments.startAddress[lastSegment];
+    
+    else if(segments.state[lastSegment] == HOLE_SEGMENT && lastSegment != processor.firstSegment){
+        int previousSegment = segments.previousSegment[lastSegment];
+        segments.nextSegment[previousSegment] = NO_SEGMENT;
+        segments.state[lastSegment] = UNUSED_SEGMENT;
+        processor.unusedSegments.push_back(lastSegment);
+        
+        if(processor.nextFitSegment == lastSegment)
+        processor.nextFitSegment = processor.firstSegment;
+    }
+    
+    else if(segments.state[lastSegment] == PROCESS_SEGMENT && totalMemory > lastEnd){
+        int holeSegment = newMemoryHoleSegment(processor, lastEnd, totalMemory - lastEnd);
+        segments.previousSegment[holeSegment] = lastSegment;
+        segments.nextSegment[lastSegment] = holeSegment;
+    }
+    
+    processor.totalMemory = totalMemory;
+    processor.maximumPlacementSize = totalMemory;
+}
+
+// Variable size partitions: the adjacent holes left by a buddy system are merged, and every hole is
+// indexed by size
+void indexRestoredMemoryHoles(CPU &processor){
+    SegmentTable &segments = processor.segments;
+    
+    for(int segment = processor.firstSegment; segment != NO_SEGMENT; segment = segments.nextSegment[segment]){
+        while(segments.state[segment] == HOLE_SEGMENT && segments.nextSegment[segment] != NO_SEGMENT && segments.state[segments.nextSegment[segment]] == HOLE_SEGMENT)
+        absorbNextMemoryHole(processor, segment);
+    }
+    
+    processor.holeIndex = HOLE_INDEX_BY_SIZE;
+    processor.memoryHolesBySize.clear();
+    processor.holeCount = 0;
+    
+    for(int segment = processor.firstSegment; segment != NO_SEGMENT; segment = segments.nextSegment[segment]){
+        if(segments.state[segment] == HOLE_SEGMENT)
+        addMemoryHoleToIndex(processor, segment);
+    }
+}
+
+// Buddy system: the holes are its free blocks, except a tail smaller than the minimum block
+void restoreBuddyMemory(CPU &processor, unsigned int minimumBlockSize){
+    BuddyAllocator &buddy = processor.buddy;
+    
+    buddy.minimumOrder = __builtin_ctz(minimumBlockSize);
+    buddy.nonEmptyOrders = 0;
+    for(int order = 0; order < BUDDY_ORDER_COUNT; order++)
+    buddy.firstFreeBlock[order] = NO_SEGMENT;
+    buddy.previousFreeBlock.clear();
+    buddy.nextFreeBlock.clear();
+    
+    processor.holeIndex = HOLE_INDEX_NONE;
+    processor.holeCount = 0;
+    
+    for(int segment = processor.firstSegment; segment != NO_SEGMENT; segment = processor.segments.nextSegment[segment]){
+        if(processor.segments.state[segment] != HOLE_SEGMENT)
+        continue;
+        
+        processor.holeCount++;
+        if(processor.segments.size[segment] >= minimumBlockSize)
+        addFreeBuddyBlock(processor, segment);
+    }
+}
+
+// Same algorithm as the checkpoint: every hole of its free lists goes back to the front of its list, the
+// last one first, so that the lists get back their order
+void restoreFreeListOrder(CPU &processor, int algorithm, const vector<int> &freeListHoles){
+    for(size_t position = freeListHoles.size(); position-- > 0; ){
+        int hole = freeListHoles[position];
+        
+        if(algorithm == BUDDY_ALGORITHM){
+            removeFreeBuddyBlock(processor, hole);
+            addFreeBuddyBlock(processor, hole);
+        }
+        else{
+            removeMemoryHoleFromSegregatedFitIndex(processor, hole);
+            addMemoryHoleToSegregatedFitIndex(processor, hole);
+        }
+    }
+}
+
+// Loads the memory map, the queue and the metrics of a checkpoint into a processor of totalMemory units
+// that goes on with algorithm (checked with canBranchCheckpoint), and builds its hole index. Returns false
+// (after reporting it) if the checkpoint is corrupted.
+bool restoreCheckpointState(const MappedFile &checkpoint, const CheckpointHeader &header, int algorithm, uint64_t totalMemory, const SimulationOptions &options, CPU &processor, Metrics &metrics){
+    CheckpointReader reader;
+    reader.cursor = checkpoint.data + sizeof(header);
+    reader.end = checkpoint.data + checkpoint.size;
+    reader.isValid = true;
+    
+    //Sizes that the file cannot hold are not allocated
+    uint64_t segmentBytes = 4 * sizeof(uint32_t) + 4 * sizeof(uint64_t);
+    if((uint64_t)header.segmentCount * segmentBytes + ((uint64_t)header.unusedSegmentCount + header.freeListHoleCount) * sizeof(int) > checkpoint.size){
+        cout << "Error: the checkpoint is truncated or corrupted." << endl;
+        return false;
+    }
+    
+    readCheckpointValues(reader, &metrics, 1);
+    
+    initializeMemory(processor, header.totalMemory, header.granularity);
+    processor.holeIndex = HOLE_INDEX_NONE;
+    processor.memoryHolesBySize.clear();
+    processor.maximumPlacementSize = header.maximumPlacementSize;
+    processor.elapsedTimeUnits = header.elapsedTimeUnits;
+    processor.stalledTimeUnits = header.stalledTimeUnits;
+    
+    SegmentTable &segments = processor.segments;
+    segments.startAddress.resize(header.segmentCount);
+    segments.size.resize(header.segmentCount);
+    segments.state.resize(header.segmentCount);
+    segments.processId.resize(header.segmentCount);
+    segments.finishTime.resize(header.segmentCount);
+    segments.requestedSize.resize(header.segmentCount);
+    segments.previousSegment.resize(header.segmentCount);
+    segments.nextSegment.resize(header.segmentCount);
+    processor.unusedSegments.resize(header.unusedSegmentCount);
+    vector<int> freeListHoles(header.freeListHoleCount);
+    
+    readCheckpointValues(reader, segments.startAddress.data(), header.segmentCount);
+    readCheckpointValues(reader, segments.size.data(), header.segmentCount);
+    readCheckpointValues(reader, segments.state.data(), header.segmentCount);
+    readCheckpointValues(reader, segments.processId.data(), header.segmentCount);
+    readCheckpointValues(reader, segments.finishTime.data(), header.segmentCount);
+    readCheckpointValues(reader, segments.requestedSize.data(), header.segmentCount);
+    readCheckpointValues(reader, segments.previousSegment.data(), header.segmentCount);
+    readCheckpointValues(reader, segments.nextSegment.data(), header.segmentCount);
+    readCheckpointValues(reader, processor.unusedSegments.data(), header.unusedSegmentCount);
+    readCheckpointValues(reader, freeListHoles.data(), header.freeListHoleCount);
+    
+    vector<string> processNames(header.processNameCount);
+    for(uint32_t name = 0; name < header.processNameCount && reader.isValid; name++){
+        uint32_t nameLength = 0;
+        readCheckpointValues(reader, &nameLength, 1);
+        readCheckpointString(reader, nameLength, processNames[name]);
+    }
+    
+    for(uint32_t queued = 0; queued < header.queueLength && reader.isValid; queued++){
+        uint32_t fields[4] = {0, 0, 0, 0};
+        Process process;
+        process.memoryRequirement = 0;
+        readCheckpointValues(reader, fields, 4);
+        readCheckpointValues(reader, &process.memoryRequirement, 1);
+        
+        readCheckpointString(reader, fields[0], process.name);
+        process.arrivalTime = fields[1];
+        process.executionTimeUnits = fields[2];
+        process.remainingTimeUnits = fields[3];
+        pushProcessToQueue(processor.queue, processor.processes, addProcessToTable(processor.processes, process));
+    }
+    
+    //Walk the memory map, checking its links, to sum up the figures kept by the processor
+    uint32_t visitedSegments = 0;
+    int lastSegment = NO_SEGMENT;
+    processor.firstSegment = header.firstSegment;
+    processor.nextFitSegment = header.nextFitSegment;
+    
+    for(int segment = header.firstSegment; reader.isValid && segment != NO_SEGMENT; segment = segments.nextSegment[segment]){
+        if(segment < 0 || (uint32_t)segment >= header.segmentCount || segments.state[segment] == UNUSED_SEGMENT || ++visitedSegments > header.segmentCount
+        || segments.previousSegment[segment] != lastSegment || (segments.state[segment] == PROCESS_SEGMENT && segments.processId[segment] >= header.processNameCount)){
+            reader.isValid = false;
+            break;
+        }
+        
+        //Each resident process takes a handle of its own, only its name is needed there
+        if(segments.state[segment] == PROCESS_SEGMENT){
+            Process process = {processNames[segments.processId[segment]], 0, (uint64_t)segments.requestedSize[segment] * processor.granularity, 0, 0};
+            segments.processId[segment] = addProcessToTable(processor.processes, process);
+            processor.usedMemory += segments.size[segment];
+            processor.internalFragmentation += segments.size[segment] - segments.requestedSize[segment];
+            processor.completions.push(make_pair(segments.finishTime[segment], segment));
+        }
+        lastSegment = segment;
+    }
+    
+    for(size_t position = 0; reader.isValid && position < freeListHoles.size(); position++){
+        int hole = freeListHoles[position];
+        
+        if(hole < 0 || (uint32_t)hole >= header.segmentCount || segments.state[hole] != HOLE_SEGMENT
+        || (header.algorithm == BUDDY_ALGORITHM && segments.size[hole] < header.buddyMinimumBlockSize))
+        reader.isValid = false;
+    }
+    
+    if(!reader.isValid || lastSegment == NO_SEGMENT || header.nextFitSegment < 0 || (uint32_t)header.nextFitSegment >= header.segmentCount){
+        cout << "Error: the checkpoint is truncated or corrupted." << endl;
+        return false;
+    }
+    
+    if(segments.state[processor.nextFitSegment] == UNUSED_SEGMENT)
+    processor.nextFitSegment = processor.firstSegment;
+    
+    if(totalMemory != header.totalMemory)
+    resizeRestoredMemory(processor, totalMemory, lastSegment);
+    
+    if(algorithm == BUDDY_ALGORITHM)
+    restoreBuddyMemory(processor, options.buddyMinimumBlockSize);
+    else{
+        indexRestoredMemoryHoles(processor);
+        
+        if(algorithm == FIRST_FIT_ALGORITHM)
+        initializeFirstFitIndex(processor);
+        else if(algorithm == TLSF_ALGORITHM)
+        initializeSegregatedFitIndex(processor);
+    }
+    
+    if(algorithm == header.algorithm)
+    restoreFreeListOrder(processor, algorithm, freeListHoles);
+    
+    return true;
+}
+
+// Resumes the arrivals of a trace at the checkpoint. A sorted trace is mapped and read from the chunk of
+// the next arrival on, so this does not depend on the length of the trace; any other one is sorted again.
+// Returns false (after reporting it) if the trace is not the one of the checkpoint.
+bool restoreArrivalStream(const string &importFileName, const CheckpointHeader &header, const SimulationOptions &options, ArrivalStream &arrivals){
+    if(header.traceOffset == NO_TRACE_OFFSET){
+        if(!openArrivalStream(importFileName, options, arrivals))
+        return false;
+    }
+    else{
+        arrivals.source = ARRIVALS_FROM_TRACE;
+        arrivals.totalProcesses = header.totalProcesses;
+        arrivals.chunkSize = options.arrivalChunkSize;
+        arrivals.chunk.clear();
+        arrivals.pending = NULL;
+        arrivals.pendingCount = 0;
+        arrivals.chunkPosition = 0;
+        arrivals.runs.clear();
+        arrivals.runHeads.clear();
+        
+        if(!openTraceReader(importFileName, arrivals.trace))
+        return false;
+        
+        arrivals.traceSize = arrivals.trace.file.size;
+    }
+    
+    if(arrivals.traceSize != header.traceSize || arrivals.totalProcesses != header.totalProcesses){
+        cout << "Error: '" << importFileName << "' is not the trace the checkpoint was taken from." << endl;
+        closeArrivalStream(arrivals);
+        return false;
+    }
+    
+    if(header.traceOffset != NO_TRACE_OFFSET){
+        static const long pageSize = sysconf(_SC_PAGESIZE);
+        
+        arrivals.trace.cursor = arrivals.trace.file.data + header.traceOffset;
+        arrivals.trace.releasedUntil = arrivals.trace.file.data + header.traceOffset - header.traceOffset % pageSize;
+        arrivals.trace.lineNumber = header.traceLineNumber;
+        arrivals.trace.remainingRecords = header.traceRemainingRecords;
+        
+        refillArrivalChunk(arrivals);
+        arrivals.consumedArrivals = header.consumedArrivals - header.chunkPosition;
+    }
+    
+    //The arrivals already taken: those of the current chunk, or every one for a trace sorted again
+    while(arrivals.consumedArrivals < header.consumedArrivals && hasPendingArrivals(arrivals))
+    popArrival(arrivals);
+    
+    return true;
+}
+
+// Placement policies: each one chooses the hole where a process is placed, both for new arrivals and
+// for queued processes. The simulation is a template instantiated for every policy, so the choice is
+// resolved at compile time and inlined in the simulation loop. A policy also decides how much memory a
+// process takes and what happens to the memory of a finished process.
+// Variable size partitions: processes take exactly their memory requirement, and freed memory is merged
+// with the adjacent holes.
+struct CoalescingPolicy{
+    static const bool roundsUpMemory = false;
+    static const bool supportsCompaction = true;
+    static const bool fitsDependOnListOrder = false; // Whether a process fits may change with the order of the hole lists alone
+    
+    static void prepareMemory(CPU &, const SimulationOptions &){
+    }
+    
+    static uint64_t occupiedMemory(const CPU &, uint64_t memoryRequirement){
+        return memoryRequirement;
+    }
+    
+    static void releaseMemoryHole(CPU &processor, int holeSegment){
+        mergeMemoryHoleWithNeighbours(processor, holeSegment);
+    }
+    
+    // Biggest memory requirement that may fit in a hole
+    static uint64_t largestMemoryHole(const CPU &processor){
+        if(processor.memoryHolesBySize.empty())
+        return 0;
+        
+        return processor.memoryHolesBySize.rbegin()->first.first;
+    }
+};
+
+struct FirstFitPolicy : CoalescingPolicy{
+    static void prepareMemory(CPU &processor, const SimulationOptions &){
+        initializeFirstFitIndex(processor);
+    }
+    
+    static int findMemoryHole(CPU &processor, uint64_t memoryRequirement){
+        return findFirstFitMemoryHole(processor, memoryRequirement);
+    }
+};
+
+struct BestFitPolicy : CoalescingPolicy{
+    static int findMemoryHole(CPU &processor, uint64_t memoryRequirement){
+        return findBestFitMemoryHole(processor, memoryRequirement);
+    }
+};
+
+struct NextFitPolicy : CoalescingPolicy{
+    static int findMemoryHole(CPU &processor, uint64_t memoryRequirement){
+        return findNextFitMemoryHole(processor, memoryRequirement);
+    }
+};
+
+struct WorstFitPolicy : CoalescingPolicy{
+    static int findMemoryHole(CPU &processor, uint64_t memoryRequirement){
+        return findWorstFitMemoryHole(processor, memoryRequirement);
+    }
+};
+
+// TLSF: constant time search, holes merged right away like the other variable size partitions
+struct SegregatedFitPolicy : CoalescingPolicy{
+    static const bool fitsDependOnListOrder = true; // Only the first hole of the request's own class is tried
+    
+    static void prepareMemory(CPU &processor, const SimulationOptions &){
+        initializeSegregatedFitIndex(processor);
+    }
+    
+    static int findMemoryHole(CPU &processor, uint64_t memoryRequirement){
+        return findSegregatedFitMemoryHole(processor, memoryRequirement);
+    }
+    
+    static uint64_t largestMemoryHole(const CPU &processor){
+        return largestSegregatedFitClassSize(processor);
+    }
+};
+
+// Buddy system: processes take a power of two block, and freed blocks are merged only with their buddy
+struct BuddyPolicy{
+    static const bool roundsUpMemory = true;
+    static const bool supportsCompaction = false; // Blocks must stay aligned to their size
+    static const bool fitsDependOnListOrder = false;
+    
+    static void prepareMemory(CPU &processor, const SimulationOptions &options){
+        initializeBuddyMemory(processor, options.buddyMinimumBlockSize);
+    }
+    
+    static uint64_t occupiedMemory(const CPU &processor, uint64_t memoryRequirement){
+        return buddyBlockSize(processor, memoryRequirement);
+    }
+    
+    static int findMemoryHole(CPU &processor, uint64_t blockSize){
+        return findBuddyMemoryBlock(processor, blockSize);
+    }
+    
+    static void releaseMemoryHole(CPU &processor, int blockSegment){
+        releaseBuddyMemoryBlock(processor, blockSegment);
+    }
+    
+    static uint64_t largestMemoryHole(const CPU &processor){
+        if(processor.buddy.nonEmptyOrders == 0)
+        return 0;
+        
+        return 1ull << (63 - __builtin_clzll(processor.buddy.nonEmptyOrders));
+    }
+};
+
+// Compacts memory so that a hole of occupiedMemory units appears, charging the processor for the memory
+// moved. Returns false if there is not enough free memory.
+bool compactMemory(CPU &processor, Metrics &metrics, uint64_t occupiedMemory, const SimulationOptions &options){
+    int firstSegment, lastSegment;
+    long long movedMemory;
+    
+    if(!findCompactionRun(processor, occupiedMemory, options.compaction == FULL_COMPACTION, firstSegment, lastSegment))
+    return false;
+    
+    compactMemorySegments(processor, firstSegment, lastSegment, movedMemory);
+    
+    if(movedMemory > 0){
+        long long compactionTimeUnits = (long long)ceil(movedMemory * processor.granularity * options.compactionCost);
+        
+        processor.stalledTimeUnits += compactionTimeUnits;
+        metrics.compactions++;
+        metrics.compactedMemory += movedMemory;
+        metrics.compactionTimeUnits += compactionTimeUnits;
+    }
+    
+    return true;
+}
+
+// Places the queued process given by its sequence number if it fits, compacting memory first if needed
+// and allowed. Returns whether it was placed.
+template <class PlacementPolicy>
+bool moveProcessFromQueueToCPU(CPU &processor, uint64_t queuedSequence, bool mayCompact, Metrics &metrics, const SimulationOptions &options){
+    uint32_t handle = queuedProcessHandle(processor.queue, queuedSequence);
+    const Process &process = processor.processes.processes[handle];
+    
+    // Check if there's a suitable memory hole for the process
+    uint64_t granules = requiredGranules(processor, process.memoryRequirement);
+    uint64_t occupiedMemory = PlacementPolicy::occupiedMemory(processor, granules);
+    int memoryHoleSegment = PlacementPolicy::findMemoryHole(processor, occupiedMemory);
+    PROFILE_COUNT(placementSearches, 1);
+    
+    //If no hole is big enough but all of them together are, they are joined by compacting memory
+    if(memoryHoleSegment == NO_SEGMENT && mayCompact && PlacementPolicy::supportsCompaction && options.compaction != NO_COMPACTION
+    && compactMemory(processor, metrics, occupiedMemory, options))
+    memoryHoleSegment = PlacementPolicy::findMemoryHole(processor, occupiedMemory);
+    
+    if(memoryHoleSegment == NO_SEGMENT)
+    return false;
+    
+    metrics.roundedUpMemory += occupiedMemory - granules;
+    metrics.requestedMemory += process.memoryRequirement;
+    metrics.granularityWaste += (uint64_t)granules * processor.granularity - process.memoryRequirement;
+    
+    //Remove the process from the queue
+    removeProcessFromQueue(processor.queue, processor.processes, queuedSequence);
+    placeProcessInMemoryHole(processor, memoryHoleSegment, handle, occupiedMemory);
+    metrics.successfulAllocations++;
+    metrics.allocationFailures--; // Compensate for initial failure count
+    
+    return true;
+}
+
+// Backfilling: while the oldest process does not fit, the biggest queued process that fits in the biggest
+// hole is placed instead. Returns whether one was placed.
+template <class PlacementPolicy>
+bool backfillProcessFromQueueToCPU(CPU &processor, Metrics &metrics, const SimulationOptions &options){
+    //Processes are queued by their memory units, and the biggest hole holds every process up to its last unit
+    uint64_t largestMemoryHole = (uint64_t)PlacementPolicy::largestMemoryHole(processor) * processor.granularity;
+    
+    for(uint64_t sequence = biggestQueuedProcessUpTo(processor.queue, largestMemoryHole); sequence != NO_QUEUED_PROCESS;
+    sequence = biggestQueuedProcessUpTo(processor.queue, largestMemoryHole)){
+        //The biggest hole is only an upper limit for some policies (e.g. TLSF classes)
+        uint64_t memoryRequirement = queuedProcess(processor, sequence).memoryRequirement;
+        
+        if(moveProcessFromQueueToCPU<PlacementPolicy>(processor, sequence, false, metrics, options))
+        return true;
+        
+        if(memoryRequirement == 0)
+        break;
+        
+        largestMemoryHole = memoryRequirement - 1;
+    }
+    
+    return false;
+}
+
+// Drops a process that could not fit even in an empty memory
+void discardQueuedProcess(CPU &processor, uint64_t sequence){
+    uint32_t handle = queuedProcessHandle(processor.queue, sequence);
+    
+    removeProcessFromQueue(processor.queue, processor.processes, sequence);
+    releaseProcessHandle(processor.processes, handle);
+}
+
+// Places queued processes in the order of the queue policy until the one it picks does not fit.
+// Processes that could not fit even in an empty memory are discarded when the policy gets to them.
+template <class PlacementPolicy>
+void moveProcessesFromQueueToCPU(CPU &processor, Metrics &metrics, const SimulationOptions &options, int currentTime){
+    ProcessQueue &queue = processor.queue;
+    
+    while(queue.length != 0){
+        
+        //FIFO: if the oldest doesn't fit even when the processor is empty, remove it
+        if(options.queuePolicy == FIFO_QUEUE){
+            if(requiredGranules(processor, queuedProcess(processor, queue.head).memoryRequirement) > processor.maximumPlacementSize){
+                discardQueuedProcess(processor, queue.head);
+                continue;
+            }
+            
+            if(!moveProcessFromQueueToCPU<PlacementPolicy>(processor, queue.head, true, metrics, options))
+            break;
+            
+            continue;
+        }
+        
+        //Other policies may pick any process, so every oversized one is removed
+        if(requiredGranules(processor, queue.processesBySize.rbegin()->first) > processor.maximumPlacementSize){
+            discardQueuedProcess(processor, queue.processesBySize.rbegin()->second);
+            continue;
+        }
+        
+        uint64_t sequence = queue.head;
+        
+        if(options.queuePolicy == SMALLEST_FIRST_QUEUE
+        || (options.queuePolicy == AGING_QUEUE && currentTime - (long long)queuedProcess(processor, queue.head).arrivalTime < options.queueAgingLimit))
+        sequence = smallestQueuedProcess(queue);
+        
+        if(moveProcessFromQueueToCPU<PlacementPolicy>(processor, sequence, true, metrics, options))
+        continue;
+        
+        if(options.queuePolicy != BACKFILL_QUEUE || !backfillProcessFromQueueToCPU<PlacementPolicy>(processor, metrics, options))
+        break;
+    }
+    
+    processor.hasPlacedSinceQueueRetry = false;
+}
+
+// Places the next arrival, or queues it if it does not fit. Returns its segment, NO_SEGMENT if queued.
+template <class PlacementPolicy>
+int allocateProcessToCPU(ArrivalStream &arrivals, CPU &processor, Metrics &metrics){
+    
+    // Check if there's a suitable memory hole for the first process
+    uint64_t granules = requiredGranules(processor, nextArrival(arrivals).memoryRequirement);
+    uint64_t occupiedMemory = PlacementPolicy::occupiedMemory(processor, granules);
+    int memoryHoleSegment = PlacementPolicy::findMemoryHole(processor, occupiedMemory);
+    PROFILE_COUNT(placementSearches, 1);
+    
+    uint32_t handle = addProcessToTable(processor.processes, nextArrival(arrivals));
+    
+    //If the first pending arrival fits in a memory hole
+    if(memoryHoleSegment != NO_SEGMENT){
+        //Insert the process that fits, leaving the remaining memory as a new hole
+        metrics.roundedUpMemory += occupiedMemory - granules;
+        metrics.requestedMemory += nextArrival(arrivals).memoryRequirement;
+        metrics.granularityWaste += (uint64_t)granules * processor.granularity - nextArrival(arrivals).memoryRequirement;
+        placeProcessInMemoryHole(processor, memoryHoleSegment, handle, occupiedMemory);
+        metrics.successfulAllocations++;
+    }
+    else{
+        //If it doesn't fit in any hole, add to queue
+        pushProcessToQueue(processor.queue, processor.processes, handle);
+        metrics.allocationFailures++;
+    }
+    
+    popArrival(arrivals);
+    return memoryHoleSegment;
+}
+
+// State of a memory bank from a time unit on, until its next sample (multi-bank mode)
+struct MetricSample{
+    int time;
+    uint64_t usedMemory;
+    uint64_t holeCount;
+    uint64_t internalFragmentation;
+    uint32_t queueLength;
+    long long queueArrivalTimeSum;
+};
+
+// Adds a sample of the processor from time on, unless nothing changed since the previous one
+void recordMetricSample(vector<MetricSample> &samples, const CPU &processor, int time){
+    MetricSample sample;
+    sample.time = time;
+    sample.usedMemory = processor.usedMemory;
+    sample.holeCount = processor.holeCount;
+    sample.internalFragmentation = processor.internalFragmentation;
+    sample.queueLength = processor.queue.length;
+    sample.queueArrivalTimeSum = processor.queue.arrivalTimeSum;
+    
+    if(!samples.empty()){
+        const MetricSample &last = samples.back();
+        
+        if(last.usedMemory == sample.usedMemory && last.holeCount == sample.holeCount && last.internalFragmentation == sample.internalFragmentation
+        && last.queueLength == sample.queueLength && last.queueArrivalTimeSum == sample.queueArrivalTimeSum)
+        return;
+    }
+    
+    samples.push_back(sample);
+}
+
+// Progress of a simulation, which may be advanced in several steps
+struct SimulationRun{
+    int currentTime;              // Next time unit to simulate
+    bool shouldContinueExecution; // Processes still running or waiting
+    bool hasRetriedQueue;         // The run stopped right before the arrivals of currentTime
+    bool isSkipCutShort;          // Event-driven mode: currentTime is idle, unless an arrival comes then
+    bool isFinished;
+    long long nextCheckpointTime;
+    vector<MetricSample> *samples; // Multi-bank mode: state of every time unit in which it changed, NULL otherwise
+};
+
+// Prepares a simulation that starts at firstTime. A simulation restored from a checkpoint starts at its
+// time unit, with the memory map of the checkpoint.
+template <class PlacementPolicy>
+void startSimulation(SimulationRun &run, CPU &processor, Metrics &metrics, const SimulationOptions &options, int firstTime){
+    
+    //A restored memory map comes with its indexes rebuilt
+    if(options.restoreFileName.empty())
+    PlacementPolicy::prepareMemory(processor, options);
+    
+    metrics.reportsInternalFragmentation = PlacementPolicy::roundsUpMemory;
+    metrics.reportsCompaction = PlacementPolicy::supportsCompaction && options.compaction != NO_COMPACTION;
+    
+    // true -> continue with the next time instant
+    // false -> stop execution
+    run.shouldContinueExecution = true;
+    run.currentTime = firstTime;
+    run.hasRetriedQueue = false;
+    run.isSkipCutShort = false;
+    run.isFinished = false;
+    run.samples = NULL;
+    
+    unsigned int checkpointInterval = options.checkpointInterval;
+    run.nextCheckpointTime = checkpointInterval == 0 ? -1 : ((long long)firstTime / checkpointInterval + 1) * checkpointInterval;
+}
+
+// Runs the simulation until every process has arrived and finished, or until stopTime: then it stops
+// right after retrying the queue of stopTime, before its arrivals, so the caller may place some. With
+// moreArrivals, the simulation does not finish when it runs out of arrivals, since more may come later.
+// The memory map is dumped through writer, unless it is NULL.
+template <class PlacementPolicy>
+void advanceSimulation(SimulationRun &run, ArrivalStream &arrivals, CPU &processor, Metrics &metrics, MemoryMapWriter *writer, const SimulationOptions &options, int algorithm, int stopTime, bool moreArrivals){
+    unsigned int checkpointInterval = options.checkpointInterval;
+    
+    //Controls the time instants
+    for(int currentTime = run.currentTime; run.shouldContinueExecution == true || hasPendingArrivals(arrivals) || moreArrivals; currentTime++){
+        run.currentTime = currentTime;
+        
+        //Save the state at the start of this time unit, once per interval (the first time unit after it when skipping)
+        if(checkpointInterval != 0 && currentTime >= run.nextCheckpointTime){
+            writeCheckpoint(checkpointFileName(options.checkpointPrefix, currentTime), algorithm, currentTime, arrivals, processor, metrics, options);
+            run.nextCheckpointTime = ((long long)currentTime / checkpointInterval + 1) * checkpointInterval;
+        }
+        
+        //Retry the processes waiting in the queue
+        PROFILE_PHASE_BEGIN(PROFILE_QUEUE_RETRIES);
+        if(!run.hasRetriedQueue)
+        moveProcessesFromQueueToCPU<PlacementPolicy>(processor, metrics, options, currentTime);
+        PROFILE_PHASE_END(PROFILE_QUEUE_RETRIES);
+        
+        run.hasRetriedQueue = currentTime == stopTime;
+        if(run.hasRetriedQueue)
+        return;
+        
+        int completedBefore = metrics.processesCompleted;
+        
+        //A skip cut short by the previous stopTime goes on through this time unit if nothing arrives in it
+        if(run.isSkipCutShort && !(hasPendingArrivals(arrivals) && (int)nextArrival(arrivals).arrivalTime == currentTime))
+        currentTime--;
+        else{
+            //Relocate the original processes
+            PROFILE_PHASE_BEGIN(PROFILE_ARRIVALS);
+            while(hasPendingArrivals(arrivals) && (int)nextArrival(arrivals).arrivalTime == currentTime){		
+                allocateProcessToCPU<PlacementPolicy>(arrivals, processor, metrics);
+            }		
+            PROFILE_PHASE_END(PROFILE_ARRIVALS);
             
-            bool wasProcessRemoved;
+            //Print running processes at this time instant to file only
+            PROFILE_PHASE_BEGIN(PROFILE_OUTPUT);
+            if(writer != NULL)
+            writeMemoryMapTimeInstant(*writer, processor, currentTime);
+            PROFILE_PHASE_END(PROFILE_OUTPUT);
             
-            do{
-                wasProcessRemoved = false;
-                
-                //If it doesn't fit even when the processor is empty, remove it
-                if( !processor.queue.empty() && (processor.queue[0].memoryRequirement > processor.totalMemory)){
-                    processor.queue.erase(processor.queue.begin());
-                    wasProcessRemoved = true;
-                }
-                
-                //If it could potentially fit...
-                else if (!processor.queue.empty()){
-                    moveProcessFromQueueToCPU(processor, wasProcessRemoved, metrics);
-                }
-                
-            }while(wasProcessRemoved == true);
+            // Update metrics for this time step
+            PROFILE_PHASE_BEGIN(PROFILE_METRICS);
+            updateMetrics(metrics, processor, currentTime, processor.totalMemory);
+            if(run.samples != NULL)
+            recordMetricSample(*run.samples, processor, currentTime);
+            PROFILE_PHASE_END(PROFILE_METRICS);
             
+            run.shouldContinueExecution = shouldContinueSimulation(processor.queue, processor);
             
-            //Relocate the original processes
-            while(!processes.empty() && (int)processes[0].arrivalTime == currentTime){		
-                allocateProcessToCPU(processes, processor, metrics);
-            }		
+            PROFILE_PHASE_BEGIN(PROFILE_COMPLETIONS);
+            decreaseProcessesTimeUnitsAndConvertFinishedIntoHoles<PlacementPolicy>(processor, metrics);
+            PROFILE_PHASE_END(PROFILE_COMPLETIONS);
             
-            //We need to take into account the memory positions occupied by previous processes
-            int startPosition = 0;
+            metrics.totalSimulationTime = currentTime;
+        }
+        run.isSkipCutShort = false;
+        
+        //Jump to the time unit before the next arrival or completion
+        PROFILE_PHASE_BEGIN(PROFILE_IDLE_SKIPS);
+        if(options.eventDriven && (run.shouldContinueExecution == true || hasPendingArrivals(arrivals) || moreArrivals)){
+            currentTime = skipIdleTimeUnits<PlacementPolicy>(arrivals, processor, metrics, currentTime, completedBefore, options, stopTime);
             
-            //Print running processes at this time instant to file only
-            for(int i = 0; i < (int)processor.runningProcesses.size(); i++){
-                
-                file_exported << "[" << startPosition << " " 
-                << processor.runningProcesses[i].name << " " 
-                << processor.runningProcesses[i].memoryRequirement << "] ";
-                
-                startPosition += processor.runningProcesses[i].memoryRequirement;
-            }  
+            //The skipped time units have the memory map of currentTime, already sampled. Stopping at stopTime
+            //with no event there leaves the skip to be finished once the arrivals of stopTime are known.
+            if(currentTime + 1 == stopTime)
+            run.isSkipCutShort = countIdleTimeUnitsUntilNextEvent<PlacementPolicy>(arrivals, processor, currentTime, completedBefore, metrics, options, INT_MAX) > 0;
+        }
+        PROFILE_PHASE_END(PROFILE_IDLE_SKIPS);
+    }
+    
+    //From now on the memory map is the one left by the last completions
+    run.isFinished = true;
+    run.currentTime = metrics.totalSimulationTime + 1;
+    if(run.samples != NULL)
+    recordMetricSample(*run.samples, processor, run.currentTime);
+}
+
+// Runs the simulation from firstTime until every process has arrived and finished. The memory map is
+// dumped through writer, unless it is NULL.
+template <class PlacementPolicy>
+void simulateArrivals(ArrivalStream &arrivals, CPU &processor, Metrics &metrics, MemoryMapWriter *writer, const SimulationOptions &options, int algorithm, int firstTime){
+    SimulationRun run;
+    
+    startSimulation<PlacementPolicy>(run, processor, metrics, options, firstTime);
+    advanceSimulation<PlacementPolicy>(run, arrivals, processor, metrics, writer, options, algorithm, INT_MAX, false);
+}
+
+// Picks the simulation instantiated for the algorithm. Only done once per simulation.
+void simulateArrivalsUsingAlgorithm(int algorithm, ArrivalStream &arrivals, CPU &processor, Metrics &metrics, MemoryMapWriter *writer, const SimulationOptions &options, int firstTime){
+    switch(algorithm){
+        case FIRST_FIT_ALGORITHM:
+            simulateArrivals<FirstFitPolicy>(arrivals, processor, metrics, writer, options, algorithm, firstTime);
+        break;
+        
+        case BEST_FIT_ALGORITHM:
+            simulateArrivals<BestFitPolicy>(arrivals, processor, metrics, writer, options, algorithm, firstTime);
+        break;
+        
+        case NEXT_FIT_ALGORITHM:
+            simulateArrivals<NextFitPolicy>(arrivals, processor, metrics, writer, options, algorithm, firstTime);
+        break;
+        
+        case WORST_FIT_ALGORITHM:
+            simulateArrivals<WorstFitPolicy>(arrivals, processor, metrics, writer, options, algorithm, firstTime);
+        break;
+        
+        case BUDDY_ALGORITHM:
+            simulateArrivals<BuddyPolicy>(arrivals, processor, metrics, writer, options, algorithm, firstTime);
+        break;
+        
+        case TLSF_ALGORITHM:
+            simulateArrivals<SegregatedFitPolicy>(arrivals, processor, metrics, writer, options, algorithm, firstTime);
+        break;
+    }
+}
+
+// Multi-bank mode: the memory is split into independent banks, each one with its own memory map, queue
+// and simulation on its own thread. A router assigns every arrival to a bank, and that is the only time
+// the banks wait for each other. Round robin does not depend on the banks, so the arrivals of a whole
+// epoch of time units are assigned at once; the other routers look at the banks, which stop at every time
+// unit with arrivals so that the router places them itself. Every bank records its state each time it
+// changes, and between epochs the samples of all of them are merged into the state of the whole memory,
+// which the metrics are taken from as for a single memory.
+const int BANK_EPOCH_TIME_UNITS = 4096;
+
+struct MemoryBank{
+    CPU processor;
+    Metrics metrics;
+    SimulationRun run;
+    vector<Process> routedArrivals;  // Round robin: arrivals assigned to the bank
+    ArrivalStream arrivals;          // Reads routedArrivals
+    MemoryMapWriter writer;
+    bool hasWriter;
+    vector<MetricSample> samples[2]; // Epochs alternate between both, so one is merged while the other fills
+    MetricSample mergedState;        // State of the bank at the time unit the merge has got to
+};
+
+struct BankSchedule{
+    mutex lock;
+    condition_variable banksWakeup;
+    condition_variable coordinatorWakeup;
+    int epoch;         // Raised by the coordinator to start every bank on the next epoch
+    int stopTime;      // The banks stop right before the arrivals of this time unit
+    bool moreArrivals; // Arrivals are still to be routed
+    bool isOver;
+    size_t runningBanks; // Banks that have not stopped yet in this epoch
+};
+
+template <class PlacementPolicy>
+void runMemoryBank(MemoryBank *bank, BankSchedule *schedule, const SimulationOptions *options, int algorithm){
+    for(int epoch = 1; ; epoch++){
+        int stopTime;
+        bool moreArrivals;
+        
+        {
+            unique_lock<mutex> guard(schedule->lock);
+            while(schedule->epoch < epoch && !schedule->isOver)
+            schedule->banksWakeup.wait(guard);
             
-            file_exported << endl;
+            if(schedule->isOver)
+            return;
             
-            // Update metrics for this time step
-            updateMetrics(metrics, processor, currentTime, totalMemory);
+            stopTime = schedule->stopTime;
+            moreArrivals = schedule->moreArrivals;
+        }
+        
+        bank->run.samples = &bank->samples[epoch % 2];
+        if(!bank->run.isFinished)
+        advanceSimulation<PlacementPolicy>(bank->run, bank->arrivals, bank->processor, bank->metrics, bank->hasWriter ? &bank->writer : NULL, *options, algorithm, stopTime, moreArrivals);
+        
+        lock_guard<mutex> guard(schedule->lock);
+        if(--schedule->runningBanks == 0)
+        schedule->coordinatorWakeup.notify_one();
+    }
+}
+
+// Round robin: the bank reads its arrivals from routedArrivals, which only holds the ones not placed yet
+void routeArrivalToBank(MemoryBank &bank, const Process &process){
+    if(!hasPendingArrivals(bank.arrivals)){
+        bank.routedArrivals.clear();
+        bank.arrivals.chunkPosition = 0;
+    }
+    
+    bank.routedArrivals.push_back(process);
+    bank.arrivals.pending = bank.routedArrivals.data();
+    bank.arrivals.pendingCount = bank.routedArrivals.size();
+    bank.metrics.totalProcesses++;
+}
+
+// Least loaded and best fit routers, with the banks stopped
+template <class PlacementPolicy>
+int chooseMemoryBank(const vector<MemoryBank> &banks, const Process &process, int router){
+    if(router == BEST_FIT_ROUTER){
+        int bestBank = -1;
+        uint64_t bestHole = 0;
+        
+        for(size_t bank = 0; bank < banks.size(); bank++){
+            const CPU &processor = banks[bank].processor;
+            uint64_t largestHole = PlacementPolicy::largestMemoryHole(processor);
+            
+            if(largestHole >= PlacementPolicy::occupiedMemory(processor, requiredGranules(processor, process.memoryRequirement)) && (bestBank == -1 || largestHole < bestHole)){
+                bestBank = bank;
+                bestHole = largestHole;
+            }
+        }
+        
+        if(bestBank != -1)
+        return bestBank;
+    }
+    
+    int leastLoadedBank = 0;
+    for(size_t bank = 1; bank < banks.size(); bank++){
+        const CPU &candidate = banks[bank].processor;
+        const CPU &leastLoaded = banks[leastLoadedBank].processor;
+        
+        if((double)candidate.usedMemory * leastLoaded.totalMemory < (double)leastLoaded.usedMemory * candidate.totalMemory)
+        leastLoadedBank = bank;
+    }
+    
+    return leastLoadedBank;
+}
+
+// Replaces the state of a bank in combined, the sum of the states of all of them
+void applyBankSample(MetricSample &bankState, const MetricSample &sample, CPU &combined){
+    combined.usedMemory += sample.usedMemory - bankState.usedMemory;
+    combined.holeCount += sample.holeCount - bankState.holeCount;
+    combined.internalFragmentation += sample.internalFragmentation - bankState.internalFragmentation;
+    combined.queue.length += (long long)sample.queueLength - bankState.queueLength;
+    combined.queue.arrivalTimeSum += sample.queueArrivalTimeSum - bankState.queueArrivalTimeSum;
+    bankState = sample;
+}
+
+// Accounts in metrics for the time units from mergedTime up to endTime (excluded), in which the whole
+// memory is the sum of the banks, with the samples that they recorded in the epoch of the given parity
+void mergeBankSamples(vector<MemoryBank> &banks, int parity, int &mergedTime, int endTime, CPU &combined, Metrics &metrics){
+    vector<size_t> positions(banks.size(), 0);
+    
+    while(mergedTime < endTime){
+        int nextTime = endTime;
+        
+        for(size_t bank = 0; bank < banks.size(); bank++){
+            const vector<MetricSample> &samples = banks[bank].samples[parity];
             
-            shouldContinueExecution = shouldContinueSimulation(processor.queue, processor.runningProcesses, totalMemory);
+            while(positions[bank] < samples.size() && samples[positions[bank]].time <= mergedTime){
+                applyBankSample(banks[bank].mergedState, samples[positions[bank]], combined);
+                positions[bank]++;
+            }
             
-            decreaseProcessesTimeUnitsAndConvertFinishedIntoHoles(processor.runningProcesses, metrics);
-            mergeAdjacentMemoryHoles(processor.runningProcesses);
+            if(positions[bank] < samples.size() && samples[positions[bank]].time < nextTime)
+            nextTime = samples[positions[bank]].time;
+        }
+        
+        //Nothing changes until nextTime
+        updateMetrics(metrics, combined, mergedTime, combined.totalMemory);
+        if(nextTime - mergedTime > 1)
+        updateMetricsForIdleTimeUnits(metrics, combined, mergedTime + 1, nextTime - mergedTime - 1);
+        
+        mergedTime = nextTime;
+    }
+    
+    //Samples of endTime itself (the memory left by a bank that has finished) count from the next merge on
+    for(size_t bank = 0; bank < banks.size(); bank++){
+        vector<MetricSample> &samples = banks[bank].samples[parity];
+        
+        for(; positions[bank] < samples.size(); positions[bank]++)
+        applyBankSample(banks[bank].mergedState, samples[positions[bank]], combined);
+        
+        samples.clear();
+    }
+}
+
+// Runs the banks, started with their memory and no arrivals, until every process has arrived and
+// finished. metrics gets the figures taken every time unit, of the whole memory.
+template <class PlacementPolicy>
+void simulateBanks(ArrivalStream &arrivals, vector<MemoryBank> &banks, Metrics &metrics, const SimulationOptions &options, int algorithm){
+    BankSchedule schedule;
+    schedule.epoch = 0;
+    schedule.isOver = false;
+    schedule.runningBanks = 0;
+    
+    //The whole memory, as the sum of the banks
+    CPU combined;
+    combined.granularity = options.granularity;
+    combined.totalMemory = 0;
+    combined.usedMemory = 0;
+    combined.holeCount = 0;
+    combined.internalFragmentation = 0;
+    combined.queue.length = 0;
+    combined.queue.arrivalTimeSum = 0;
+    
+    for(size_t bank = 0; bank < banks.size(); bank++){
+        startSimulation<PlacementPolicy>(banks[bank].run, banks[bank].processor, banks[bank].metrics, options, 1);
+        memset(&banks[bank].mergedState, 0, sizeof(MetricSample));
+        combined.totalMemory += banks[bank].processor.totalMemory;
+    }
+    
+    vector<thread> workers;
+    for(size_t bank = 0; bank < banks.size(); bank++)
+    workers.push_back(thread(runMemoryBank<PlacementPolicy>, &banks[bank], &schedule, &options, algorithm));
+    
+    int epochStart = 1;
+    int mergedTime = 1;
+    size_t nextBank = 0;
+    
+    for(int epoch = 1; ; epoch++){
+        int stopTime = epochStart + BANK_EPOCH_TIME_UNITS;
+        
+        if(options.bankRouter == ROUND_ROBIN_ROUTER){
+            while(hasPendingArrivals(arrivals) && nextArrival(arrivals).arrivalTime < (unsigned int)stopTime){
+                routeArrivalToBank(banks[nextBank], nextArrival(arrivals));
+                nextBank = (nextBank + 1) % banks.size();
+                popArrival(arrivals);
+            }
+        }
+        else{
+            //The banks are stopped right before the arrivals of epochStart, except in the first epoch
+            while(epoch > 1 && hasPendingArrivals(arrivals) && (int)nextArrival(arrivals).arrivalTime <= epochStart){
+                MemoryBank &bank = banks[chooseMemoryBank<PlacementPolicy>(banks, nextArrival(arrivals), options.bankRouter)];
+                bank.metrics.totalProcesses++;
+                allocateProcessToCPU<PlacementPolicy>(arrivals, bank.processor, bank.metrics);
+                bank.run.isSkipCutShort = false;
+                bank.run.shouldContinueExecution = true;
+            }
             
-            metrics.totalSimulationTime = currentTime;
+            if(hasPendingArrivals(arrivals) && (int)nextArrival(arrivals).arrivalTime < stopTime)
+            stopTime = max(epochStart, (int)nextArrival(arrivals).arrivalTime);
+        }
+        
+        bool moreArrivals = hasPendingArrivals(arrivals);
+        
+        {
+            lock_guard<mutex> guard(schedule.lock);
+            schedule.epoch = epoch;
+            schedule.stopTime = stopTime;
+            schedule.moreArrivals = moreArrivals;
+            schedule.runningBanks = banks.size();
+        }
+        schedule.banksWakeup.notify_all();
+        
+        //The previous epoch is merged while the banks simulate this one
+        if(epoch > 1)
+        mergeBankSamples(banks, (epoch - 1) % 2, mergedTime, epochStart, combined, metrics);
+        
+        {
+            unique_lock<mutex> guard(schedule.lock);
+            while(schedule.runningBanks != 0)
+            schedule.coordinatorWakeup.wait(guard);
+        }
+        
+        bool isFinished = !moreArrivals;
+        int endTime = 0;
+        for(size_t bank = 0; bank < banks.size(); bank++){
+            isFinished = isFinished && banks[bank].run.isFinished;
+            endTime = max(endTime, (int)banks[bank].metrics.totalSimulationTime + 1);
+        }
+        
+        if(isFinished){
+            mergeBankSamples(banks, epoch % 2, mergedTime, endTime, combined, metrics);
+            break;
+        }
+        
+        epochStart = stopTime;
+    }
+    
+    {
+        lock_guard<mutex> guard(schedule.lock);
+        schedule.isOver = true;
+    }
+    schedule.banksWakeup.notify_all();
+    
+    for(size_t worker = 0; worker < workers.size(); worker++)
+    workers[worker].join();
+}
+
+void simulateBanksUsingAlgorithm(int algorithm, ArrivalStream &arrivals, vector<MemoryBank> &banks, Metrics &metrics, const SimulationOptions &options){
+    switch(algorithm){
+        case FIRST_FIT_ALGORITHM:
+            simulateBanks<FirstFitPolicy>(arrivals, banks, metrics, options, algorithm);
+        break;
+        
+        case BEST_FIT_ALGORITHM:
+            simulateBanks<BestFitPolicy>(arrivals, banks, metrics, options, algorithm);
+        break;
+        
+        case NEXT_FIT_ALGORITHM:
+            simulateBanks<NextFitPolicy>(arrivals, banks, metrics, options, algorithm);
+        break;
+        
+        case WORST_FIT_ALGORITHM:
+            simulateBanks<WorstFitPolicy>(arrivals, banks, metrics, options, algorithm);
+        break;
+        
+        case BUDDY_ALGORITHM:
+            simulateBanks<BuddyPolicy>(arrivals, banks, metrics, options, algorithm);
+        break;
+        
+        case TLSF_ALGORITHM:
+            simulateBanks<SegregatedFitPolicy>(arrivals, banks, metrics, options, algorithm);
+        break;
+    }
+}
+
+// Adds what happened in a bank to the metrics of the whole memory, whose figures per time unit are
+// already taken from the merged samples
+void addBankMetrics(Metrics &metrics, const Metrics &bankMetrics){
+    metrics.successfulAllocations += bankMetrics.successfulAllocations;
+    metrics.allocationFailures += bankMetrics.allocationFailures;
+    metrics.processesCompleted += bankMetrics.processesCompleted;
+    metrics.totalSimulationTime = max(metrics.totalSimulationTime, bankMetrics.totalSimulationTime);
+    metrics.reportsInternalFragmentation = bankMetrics.reportsInternalFragmentation;
+    metrics.roundedUpMemory += bankMetrics.roundedUpMemory;
+    metrics.requestedMemory += bankMetrics.requestedMemory;
+    metrics.granularityWaste += bankMetrics.granularityWaste;
+    metrics.reportsCompaction = bankMetrics.reportsCompaction;
+    metrics.compactions += bankMetrics.compactions;
+    metrics.compactedMemory += bankMetrics.compactedMemory;
+    metrics.compactionTimeUnits += bankMetrics.compactionTimeUnits;
+    
+    if(bankMetrics.finalHoleCount > 0){
+        if(metrics.finalHoleCount == 0 || bankMetrics.smallestFinalHole < metrics.smallestFinalHole) metrics.smallestFinalHole = bankMetrics.smallestFinalHole;
+        if(metrics.finalHoleCount == 0 || bankMetrics.largestFinalHole > metrics.largestFinalHole) metrics.largestFinalHole = bankMetrics.largestFinalHole;
+        metrics.finalHoleCount += bankMetrics.finalHoleCount;
+        metrics.finalHoleMemory += bankMetrics.finalHoleMemory;
+    }
+}
+
+void printBankMetrics(const vector<MemoryBank> &banks, long long totalSimulationTime){
+    cout << "========== MEMORY BANKS ==========" << endl;
+    
+    for(size_t bank = 0; bank < banks.size(); bank++){
+        const Metrics &metrics = banks[bank].metrics;
+        uint64_t bankMemory = banks[bank].processor.totalMemory;
+        
+        cout << "Bank " << bank << ": " << bankMemory * banks[bank].processor.granularity << " units, " << metrics.totalProcesses << " processes, "
+             << metrics.successfulAllocations << " allocations, " << metrics.allocationFailures << " failures, "
+             << metrics.processesCompleted << " completed";
+        
+        if(totalSimulationTime > 0 && bankMemory > 0)
+        cout << ", " << (double)metrics.totalMemoryTimeUsed / ((double)totalSimulationTime * bankMemory) * 100 << "% average utilization";
+        
+        cout << endl;
+    }
+    
+    cout << "=========================================================\n" << endl;
+}
+
+// Multi-bank mode: the memory is split evenly between options.bankCount banks (the first ones take the
+// remainder), and the memory map of bank i is dumped to <exportFileName>.<i>. totalMemory is in granules.
+void allocateProcessesToBanks(uint64_t totalMemory, string importFileName, string exportFileName, int algorithm, const SimulationOptions &options){
+    ArrivalStream arrivals;
+    
+    if(!openArrivalStream(importFileName, options, arrivals))
+    return;
+    
+    Metrics metrics;
+    initializeMetrics(metrics);
+    metrics.totalProcesses = arrivals.totalProcesses;
+    
+    vector<MemoryBank> banks(options.bankCount);
+    bool hasWriters = true;
+    
+    for(size_t bank = 0; bank < banks.size(); bank++){
+        uint64_t bankMemory = totalMemory / banks.size() + (bank < totalMemory % banks.size() ? 1 : 0);
+        
+        initializeMetrics(banks[bank].metrics);
+        initializeMemory(banks[bank].processor, bankMemory, options.granularity);
+        openSharedArrivalStream(banks[bank].routedArrivals, banks[bank].arrivals);
+        banks[bank].hasWriter = openMemoryMapWriter(exportFileName + "." + to_string(bank), options, banks[bank].writer);
+        hasWriters = hasWriters && banks[bank].hasWriter;
+    }
+    
+    if(hasWriters)
+    simulateBanksUsingAlgorithm(algorithm, arrivals, banks, metrics, options);
+    else
+    cout << "The output file could not be created" << endl;
+    
+    closeArrivalStream(arrivals);
+    
+    for(size_t bank = 0; bank < banks.size(); bank++){
+        if(banks[bank].hasWriter)
+        closeMemoryMapWriter(banks[bank].writer);
+        
+        finalizeMetrics(banks[bank].metrics, banks[bank].processor, banks[bank].processor.totalMemory);
+        addBankMetrics(metrics, banks[bank].metrics);
+    }
+    
+    printMetrics(metrics, totalMemory, options.granularity, ALGORITHM_NAMES[algorithm]);
+    printBankMetrics(banks, metrics.totalSimulationTime);
+    
+    if(options.profile)
+    cout << "Profiling is not available with several memory banks\n" << endl;
+    
+    cout << "Algorithm finished" << endl;
+}
+
+// Loads the simulation of the checkpoint options.restoreFileName to go on with the algorithm and memory
+// size given, and the rest of its trace. Returns false (after reporting it) if it cannot.
+bool restoreSimulation(const string &importFileName, uint64_t totalMemory, int algorithm, const SimulationOptions &options, ArrivalStream &arrivals, CPU &processor, Metrics &metrics, int &firstTime){
+    MappedFile checkpoint;
+    CheckpointHeader header;
+    
+    if(!openCheckpoint(options.restoreFileName, checkpoint, header))
+    return false;
+    
+    bool isRestored = canBranchCheckpoint(header, algorithm, totalMemory, options)
+    && restoreCheckpointState(checkpoint, header, algorithm, totalMemory, options, processor, metrics)
+    && restoreArrivalStream(importFileName, header, options, arrivals);
+    
+    unmapFile(checkpoint);
+    firstTime = header.resumeTime;
+    
+    if(isRestored)
+    cout << "Resumed from the checkpoint " << options.restoreFileName << " at time unit " << firstTime << endl;
+    
+    return isRestored;
+}
+
+// Simulates the trace in a memory of totalMemory granules
+void allocateProcesses(uint64_t totalMemory, string importFileName, string exportFileName, int algorithm, const SimulationOptions &options){
+    //Arrivals in arrival time order, read from the trace in chunks
+    ArrivalStream arrivals;
+    Metrics metrics;
+    CPU processor;
+    int firstTime = 1;
+    
+    if(!options.restoreFileName.empty()){
+        if(!restoreSimulation(importFileName, totalMemory, algorithm, options, arrivals, processor, metrics, firstTime))
+        return;
+    }
+    else{
+        if(!openArrivalStream(importFileName, options, arrivals))
+        return;
+        
+        // Initialize metrics
+        initializeMetrics(metrics);
+        metrics.totalProcesses = arrivals.totalProcesses;
+        
+        //Initialize a processor responsible for executing the processes,
+        //with a hole indicated by parameter
+        initializeMemory(processor, totalMemory, options.granularity);
+    }
+    
+    MemoryMapWriter writer;
+    
+#ifdef PROFILING
+    uint64_t simulationNanoseconds = 0;
+#endif
+    
+    if(openMemoryMapWriter(exportFileName, options, writer)){
+#ifdef PROFILING
+        simulationProfile = SimulationProfile();
+        uint64_t simulationStart = profileClock();
+#endif
+        simulateArrivalsUsingAlgorithm(algorithm, arrivals, processor, metrics, &writer, options, firstTime);
+#ifdef PROFILING
+        simulationNanoseconds = profileClock() - simulationStart;
+#endif
+        closeMemoryMapWriter(writer);
+    }
+    else
+    cout << "The output file could not be created" << endl;
+    
+    closeArrivalStream(arrivals);
+    
+    // Finalize and print metrics
+    finalizeMetrics(metrics, processor, totalMemory);
+    printMetrics(metrics, totalMemory, options.granularity, ALGORITHM_NAMES[algorithm]);
+    
+    if(options.profile){
+#ifdef PROFILING
+        printSimulationProfile(metrics, simulationNanoseconds);
+#else
+        cout << "Profiling is not compiled in: build with -DPROFILING to use --profile\n" << endl;
+#endif
+    }
+    
+    cout << "Algorithm finished" << endl;
+}
+
+// Streaming mode: the arrivals are trace lines read from standard input or a FIFO while the simulation
+// runs, and must come in arrival time order. Time is advanced up to every arrival as soon as its line is
+// read, the arrival is placed and the decision printed, so only the lines not read yet are buffered and
+// nothing is sorted. Rolling metrics are printed every few arrivals and whenever the input is caught up.
+struct ArrivalPipe{
+    int descriptor;
+    vector<char> buffer;
+    size_t start;           // Unread bytes: [start, end)
+    size_t end;
+    int lineNumber;         // Of the next line
+    bool isClosed;          // The writer closed the pipe
+};
+
+// "-" is standard input. Opening a FIFO waits until something opens it for writing.
+bool openArrivalPipe(const string &importFileName, ArrivalPipe &pipe){
+    pipe.descriptor = importFileName == "-" ? STDIN_FILENO : open(importFileName.c_str(), O_RDONLY);
+    pipe.buffer.resize(1 << 16);
+    pipe.start = 0;
+    pipe.end = 0;
+    pipe.lineNumber = 1;
+    pipe.isClosed = false;
+    
+    return pipe.descriptor != -1;
+}
+
+void closeArrivalPipe(ArrivalPipe &pipe){
+    if(pipe.descriptor != STDIN_FILENO)
+    close(pipe.descriptor);
+}
+
+bool hasArrivalPipeLine(const ArrivalPipe &pipe){
+    return memchr(&pipe.buffer[0] + pipe.start, '\n', pipe.end - pipe.start) != NULL;
+}
+
+// Waits for more input. Returns false once the pipe is closed and every line has been read; a last
+// line without '\n' is completed with one.
+bool fillArrivalPipe(ArrivalPipe &pipe){
+    if(pipe.isClosed)
+    return false;
+    
+    //Keep the unread bytes at the front, and make room for lines longer than the buffer
+    memmove(&pipe.buffer[0], &pipe.buffer[0] + pipe.start, pipe.end - pipe.start);
+    pipe.end -= pipe.start;
+    pipe.start = 0;
+    if(pipe.end == pipe.buffer.size())
+    pipe.buffer.resize(pipe.buffer.size() * 2);
+    
+    ssize_t result;
+    do{
+        result = read(pipe.descriptor, &pipe.buffer[0] + pipe.end, pipe.buffer.size() - pipe.end);
+    }while(result == -1 && errno == EINTR);
+    
+    if(result > 0){
+        pipe.end += result;
+        return true;
+    }
+    
+    pipe.isClosed = true;
+    if(pipe.end == 0)
+    return false;
+    
+    if(pipe.end == pipe.buffer.size())
+    pipe.buffer.resize(pipe.buffer.size() + 1);
+    pipe.buffer[pipe.end++] = '\n';
+    return true;
+}
+
+// Takes the next line, without its '\n'. Only valid while hasArrivalPipeLine.
+void takeArrivalPipeLine(ArrivalPipe &pipe, const char *&line, const char *&lineEnd){
+    line = &pipe.buffer[0] + pipe.start;
+    lineEnd = (const char *)memchr(line, '\n', pipe.end - pipe.start);
+    pipe.start += lineEnd - line + 1;
+    pipe.lineNumber++;
+}
+
+// "<time> metrics: ..." with the state at the time simulated so far and the figures since the start
+void printStreamMetrics(const CPU &processor, const Metrics &metrics, int currentTime){
+    double averageMemoryUsage = metrics.simulatedTimeSteps == 0 ? 0 : (double)metrics.totalMemoryTimeUsed / metrics.simulatedTimeSteps;
+    
+    cout << currentTime << " metrics: memory " << processor.usedMemory * processor.granularity << "/" << processor.totalMemory * processor.granularity
+    << " (average " << averageMemoryUsage / processor.totalMemory * 100 << "%), holes " << processor.holeCount
+    << ", queue " << processor.queue.length << ", arrivals " << metrics.totalProcesses << ", placed " << metrics.successfulAllocations
+    << ", not placed " << metrics.allocationFailures << ", completed " << metrics.processesCompleted << "\n";
+}
+
+template <class PlacementPolicy>
+void streamArrivals(ArrivalPipe &pipe, CPU &processor, Metrics &metrics, MemoryMapWriter *writer, const SimulationOptions &options, int algorithm){
+    SimulationRun run;
+    ArrivalStream arrivals;
+    Process process;
+    int arrivalsSinceMetrics = 0;
+    
+    //The arrival being placed is the only one in the stream
+    arrivals.source = ARRIVALS_FROM_MEMORY;
+    arrivals.pending = &process;
+    arrivals.pendingCount = 0;
+    arrivals.chunkPosition = 0;
+    arrivals.consumedArrivals = 0;
+    
+    startSimulation<PlacementPolicy>(run, processor, metrics, options, 1);
+    
+    while(true){
+        if(!hasArrivalPipeLine(pipe)){
+            //Caught up with the input: report before waiting for more
+            if(arrivalsSinceMetrics > 0)
+            printStreamMetrics(processor, metrics, run.currentTime);
+            arrivalsSinceMetrics = 0;
+            cout.flush();
+            
+            if(!fillArrivalPipe(pipe))
+            break;
+            continue;
+        }
+        
+        const char *line, *lineEnd;
+        int lineNumber = pipe.lineNumber;
+        takeArrivalPipeLine(pipe, line, lineEnd);
+        
+        if(!parseTraceLine(line, lineEnd, process)){
+            if(!isBlankTraceLine(line, lineEnd))
+            cout << "Error: line " << lineNumber << " of the input is malformed and has been skipped: \"" << string(line, lineEnd - line) << "\"\n";
+            continue;
+        }
+        
+        //The simulation cannot go back to place it
+        if(process.arrivalTime < (unsigned int)run.currentTime){
+            cout << run.currentTime << " rejected " << process.name << ": it arrives at " << process.arrivalTime << ", which has already been simulated\n";
+            continue;
+        }
+        
+        advanceSimulation<PlacementPolicy>(run, arrivals, processor, metrics, writer, options, algorithm, process.arrivalTime, true);
+        
+        arrivals.pendingCount = 1;
+        arrivals.chunkPosition = 0;
+        metrics.totalProcesses++;
+        int segment = allocateProcessToCPU<PlacementPolicy>(arrivals, processor, metrics);
+        run.isSkipCutShort = false;
+        run.shouldContinueExecution = true;
+        
+        if(segment != NO_SEGMENT)
+        cout << process.arrivalTime << " placed " << process.name << " [" << processor.segments.startAddress[segment] * processor.granularity << " " << processor.segments.size[segment] * processor.granularity << "]\n";
+        else
+        cout << process.arrivalTime << " queued " << process.name << " (" << processor.queue.length << " waiting)\n";
+        
+        if(++arrivalsSinceMetrics == (int)options.streamMetricsEvery){
+            printStreamMetrics(processor, metrics, run.currentTime);
+            arrivalsSinceMetrics = 0;
         }
+    }
+    
+    //The input is over: run until every process has finished
+    advanceSimulation<PlacementPolicy>(run, arrivals, processor, metrics, writer, options, algorithm, INT_MAX, false);
+}
+
+void streamArrivalsUsingAlgorithm(int algorithm, ArrivalPipe &pipe, CPU &processor, Metrics &metrics, MemoryMapWriter *writer, const SimulationOptions &options){
+    switch(algorithm){
+        case FIRST_FIT_ALGORITHM:
+            streamArrivals<FirstFitPolicy>(pipe, processor, metrics, writer, options, algorithm);
+        break;
+        
+        case BEST_FIT_ALGORITHM:
+            streamArrivals<BestFitPolicy>(pipe, processor, metrics, writer, options, algorithm);
+        break;
+        
+        case NEXT_FIT_ALGORITHM:
+            streamArrivals<NextFitPolicy>(pipe, processor, metrics, writer, options, algorithm);
+        break;
+        
+        case WORST_FIT_ALGORITHM:
+            streamArrivals<WorstFitPolicy>(pipe, processor, metrics, writer, options, algorithm);
+        break;
+        
+        case BUDDY_ALGORITHM:
+            streamArrivals<BuddyPolicy>(pipe, processor, metrics, writer, options, algorithm);
+        break;
         
-        file_exported.close();
+        case TLSF_ALGORITHM:
+            streamArrivals<SegregatedFitPolicy>(pipe, processor, metrics, writer, options, algorithm);
+        break;
+    }
+}
+
+// Streams the arrivals of the pipe into a memory of totalMemory granules
+void streamProcesses(uint64_t totalMemory, string importFileName, string exportFileName, int algorithm, const SimulationOptions &options){
+    ArrivalPipe pipe;
+    Metrics metrics;
+    CPU processor;
+    MemoryMapWriter writer;
+    
+    if(!openArrivalPipe(importFileName, pipe)){
+        cout << "The input '" << importFileName << "' could not be opened" << endl;
+        return;
+    }
+    
+    initializeMetrics(metrics);
+    initializeMemory(processor, totalMemory, options.granularity);
+    
+    if(openMemoryMapWriter(exportFileName, options, writer)){
+        streamArrivalsUsingAlgorithm(algorithm, pipe, processor, metrics, &writer, options);
+        closeMemoryMapWriter(writer);
     }
     else
     cout << "The output file could not be created" << endl;
     
-    // Finalize and print metrics
+    closeArrivalPipe(pipe);
+    
     finalizeMetrics(metrics, processor, totalMemory);
-    printMetrics(metrics, totalMemory, "FIRST FIT");
+    printMetrics(metrics, totalMemory, options.granularity, ALGORITHM_NAMES[algorithm]);
     
     cout << "Algorithm finished" << endl;
 }
 
-void allocateProcessesUsingBestFit(int totalMemory, string importFileName, string exportFileName){
-    vector<Process> processes;
+// Queue policy given by its command (e.g. "backfill"), -1 if there is none
+int findQueuePolicy(const char *command){
+    for(int queuePolicy = 0; queuePolicy < QUEUE_POLICY_COUNT; queuePolicy++){
+        if(strcmp(command, QUEUE_POLICY_COMMANDS[queuePolicy]) == 0)
+        return queuePolicy;
+    }
     
-    loadProcessesFromFile(importFileName, processes);
+    return -1;
+}
+
+// Reads the simulation option at argv[i], together with its value if it has one (i is moved past it).
+// Returns false if it is not a known option or its value is wrong.
+bool parseSimulationOption(int argc, char *argv[], int &i, SimulationOptions &options){
+    //Event-driven time advance
+    if(strcmp(argv[i], "--event-driven") == 0)
+        options.eventDriven = true;
     
-    sortProcessesByArrivalTime(processes);
+    //Arrivals read from the trace at a time
+    else if(strcmp(argv[i], "--arrival-chunk") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        options.arrivalChunkSize = atoi(argv[++i]);
     
-    // Initialize metrics
-    Metrics metrics;
-    initializeMetrics(metrics);
-    metrics.totalProcesses = processes.size();
+    //Processes that may be sorted in memory before sorting on disk
+    else if(strcmp(argv[i], "--sort-budget") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        options.sortMemoryBudget = atoi(argv[++i]);
     
-    //Initialize a processor responsible for executing the processes
-    CPU processor;
-    processor.totalMemory = (unsigned int) totalMemory;
+    //Memory map dump: buffer size, sampling and delta mode
+    else if(strcmp(argv[i], "--output-buffer") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        options.outputBufferSize = atoi(argv[++i]);
     
-    //Initialize the processor with a hole indicated by parameter
-    Process initialization;
-    initialization.name = "hole";
-    initialization.arrivalTime = 0;
-    initialization.remainingTimeUnits = 0;
-    initialization.executionTimeUnits = 0;
-    initialization.memoryRequirement = totalMemory;
+    else if(strcmp(argv[i], "--sample-every") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        options.outputSampleEvery = atoi(argv[++i]);
     
-    processor.runningProcesses.push_back(initialization);
+    else if(strcmp(argv[i], "--delta") == 0)
+        options.outputDeltaOnly = true;
     
-    // true -> continue with the next time instant
-    // false -> stop execution
-    bool shouldContinueExecution = true;
+    else if(strcmp(argv[i], "--output-format") == 0 && i + 1 < argc && (strcmp(argv[i + 1], "text") == 0 || strcmp(argv[i + 1], "binary") == 0))
+        options.outputBinaryHistory = strcmp(argv[++i], "binary") == 0;
     
-    ofstream file_exported;
+    else if(strcmp(argv[i], "--keyframe-every") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        options.historyKeyframeEvery = atoi(argv[++i]);
     
-    file_exported.open(exportFileName.c_str(), ios::out);
+    //Writer thread for the memory map dump, its ring capacity and backpressure policy
+    else if(strcmp(argv[i], "--async-output") == 0)
+        options.asyncOutput = true;
     
-    if(file_exported.is_open()){
-        
-        //Controls the time instants
-        for(int currentTime = 1; shouldContinueExecution == true || !processes.empty(); currentTime++){
-            
-            //Time instant printed to file only
-            file_exported << currentTime << " ";
-            
-            bool wasProcessRemoved;
-            
-            do{
-                wasProcessRemoved = false;
-                
-                //If it doesn't fit even when the processor is empty, remove it
-                if( !processor.queue.empty() && (processor.queue[0].memoryRequirement > processor.totalMemory)){
-                    processor.queue.erase(processor.queue.begin());
-                    wasProcessRemoved = true;
-                }
-                
-                //If it could potentially fit...
-                else if (!processor.queue.empty()){
-                    moveProcessFromQueueToCPU(processor, wasProcessRemoved, metrics);
-            }
+    else if(strcmp(argv[i], "--async-ring") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        options.asyncRingEntries = atoi(argv[++i]);
+    
+    else if(strcmp(argv[i], "--async-backpressure") == 0 && i + 1 < argc && (strcmp(argv[i + 1], "block") == 0 || strcmp(argv[i + 1], "drop") == 0))
+        options.asyncDropWhenFull = strcmp(argv[++i], "drop") == 0;
+    
+    //Smallest block of the buddy system, a power of two
+    else if(strcmp(argv[i], "--buddy-min-block") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0 && (atoi(argv[i + 1]) & (atoi(argv[i + 1]) - 1)) == 0)
+        options.buddyMinimumBlockSize = atoi(argv[++i]);
+    
+    //Compaction when the queued process picked next does not fit in any hole, and its cost
+    else if(strcmp(argv[i], "--compaction") == 0 && i + 1 < argc && (strcmp(argv[i + 1], "full") == 0 || strcmp(argv[i + 1], "partial") == 0))
+        options.compaction = strcmp(argv[++i], "full") == 0 ? FULL_COMPACTION : PARTIAL_COMPACTION;
+    
+    else if(strcmp(argv[i], "--compaction-cost") == 0 && i + 1 < argc && atof(argv[i + 1]) >= 0)
+        options.compactionCost = atof(argv[++i]);
+    
+    //Time per phase and placement counters
+    else if(strcmp(argv[i], "--profile") == 0)
+        options.profile = true;
+    
+    //Order in which the queued processes are tried, and waiting time after which aging serves the oldest
+    else if(strcmp(argv[i], "--queue") == 0 && i + 1 < argc && findQueuePolicy(argv[i + 1]) != -1)
+        options.queuePolicy = findQueuePolicy(argv[++i]);
+    
+    else if(strcmp(argv[i], "--queue-aging") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        options.queueAgingLimit = atoi(argv[++i]);
+    
+    //Memory units per granule, e.g. 4096 for pages of 4 KiB counted in bytes
+    else if(strcmp(argv[i], "--granularity") == 0 && i + 1 < argc && parseMemorySize(argv[i + 1], options.granularity) && options.granularity > 0)
+        i++;
+    
+    else
+        return false;
+    
+    return true;
+}
+
+// Sweep mode: every (trace, memory size, algorithm) combination is simulated without a memory map dump.
+// Each trace is read and sorted once into an array shared, read only, by all of its simulations, which
+// run on a pool of threads. Every thread owns a queue of simulations and, when it runs out of them,
+// steals from the other end of the queues of the rest. The table lists the simulations in a fixed
+// order, so it does not depend on the number of threads.
+struct SweepOptions{
+    string tableFileName;
+    vector<string> traceFileNames;
+    vector<uint64_t> memorySizes; // Memory units
+    vector<int> algorithms;
+    unsigned int threadCount; // 0 -> one per hardware thread
+    bool useJsonFormat;
+};
+
+struct SweepSimulation{
+    int trace;
+    uint64_t totalMemory; // Memory units
+    int algorithm;
+};
+
+struct SweepWorkerQueue{
+    mutex lock;
+    deque<int> simulations;
+};
+
+// Figures of printMetrics, in the order of the table columns. Figures that printMetrics would not show
+// (e.g. average waiting time without successful allocations) are marked as not defined.
+const int SWEEP_FIGURE_COUNT = 35;
+const char *const SWEEP_FIGURE_NAMES[SWEEP_FIGURE_COUNT] = {
+    "total_processes", "successful_allocations", "allocation_failures", "allocation_success_rate",
+    "processes_completed", "total_simulation_time", "average_memory_utilization", "throughput",
+    "peak_memory_usage", "average_waiting_time", "minimum_queue_length", "maximum_queue_length",
+    "average_fragmentation", "peak_fragmentation", "final_memory_holes", "average_hole_size",
+    "smallest_hole", "largest_hole", "total_fragmented_memory", "rounded_up_memory",
+    "average_internal_fragmentation", "peak_internal_fragmentation", "compactions", "compacted_memory",
+    "compaction_time", "memory_usage_p50", "memory_usage_p90", "memory_usage_p99",
+    "hole_count_p50", "hole_count_p90", "hole_count_p99", "fragmentation_p50", "fragmentation_p90",
+    "fragmentation_p99", "granularity_waste"
+};
+
+// The memory figures are given in memory units, as printMetrics does
+void computeSweepFigures(const Metrics &metrics, uint64_t totalMemory, uint64_t granularity, double figures[], bool isDefined[]){
+    for(int i = 0; i < SWEEP_FIGURE_COUNT; i++){
+        figures[i] = 0;
+        isDefined[i] = true;
+    }
+    
+    figures[0] = metrics.totalProcesses;
+    figures[1] = metrics.successfulAllocations;
+    figures[2] = metrics.allocationFailures;
+    isDefined[3] = metrics.totalProcesses > 0;
+    if(isDefined[3])
+    figures[3] = (double)metrics.successfulAllocations / metrics.totalProcesses * 100;
+    
+    figures[4] = metrics.processesCompleted;
+    figures[5] = metrics.totalSimulationTime;
+    isDefined[6] = isDefined[7] = metrics.totalSimulationTime > 0;
+    if(isDefined[6]){
+        figures[6] = (double)metrics.totalMemoryTimeUsed / ((double)metrics.totalSimulationTime * totalMemory) * 100;
+        figures[7] = (double)metrics.processesCompleted / metrics.totalSimulationTime;
+    }
+    
+    figures[8] = (double)metrics.peakMemoryUsage * granularity;
+    isDefined[9] = metrics.successfulAllocations > 0;
+    if(isDefined[9])
+    figures[9] = (double)metrics.totalWaitingTime / metrics.successfulAllocations;
+    
+    figures[10] = metrics.minQueueLength;
+    figures[11] = metrics.maxQueueLength;
+    isDefined[12] = isDefined[13] = metrics.simulatedTimeSteps > 0;
+    if(isDefined[12]){
+        figures[12] = (double)metrics.totalFragmentationTime / metrics.simulatedTimeSteps * granularity;
+        figures[13] = (double)metrics.peakFragmentation * granularity;
+    }
+    
+    figures[14] = metrics.finalHoleCount;
+    for(int i = 15; i <= 18; i++)
+    isDefined[i] = metrics.finalHoleCount > 0;
+    
+    if(metrics.finalHoleCount > 0){
+        figures[15] = (double)metrics.finalHoleMemory / metrics.finalHoleCount * granularity;
+        figures[16] = (double)metrics.smallestFinalHole * granularity;
+        figures[17] = (double)metrics.largestFinalHole * granularity;
+        figures[18] = (double)metrics.finalHoleMemory * granularity;
+    }
+    
+    isDefined[19] = metrics.reportsInternalFragmentation;
+    isDefined[20] = isDefined[21] = metrics.reportsInternalFragmentation && metrics.simulatedTimeSteps > 0;
+    figures[19] = (double)metrics.roundedUpMemory * granularity;
+    if(isDefined[20]){
+        figures[20] = (double)metrics.totalInternalFragmentationTime / metrics.simulatedTimeSteps * granularity;
+        figures[21] = (double)metrics.peakInternalFragmentation * granularity;
+    }
+    
+    isDefined[22] = isDefined[23] = isDefined[24] = metrics.reportsCompaction;
+    figures[22] = metrics.compactions;
+    figures[23] = (double)metrics.compactedMemory * granularity;
+    figures[24] = metrics.compactionTimeUnits;
+    
+    const MetricHistogram *histograms[3] = {&metrics.memoryUsageHistogram, &metrics.holeCountHistogram, &metrics.fragmentationHistogram};
+    const double percentiles[3] = {50, 90, 99};
+    for(int histogram = 0; histogram < 3; histogram++){
+        for(int percentile = 0; percentile < 3; percentile++){
+            int figure = 25 + histogram * 3 + percentile;
+            isDefined[figure] = metrics.simulatedTimeSteps > 0;
+            if(isDefined[figure])
+            figures[figure] = metricHistogramPercentile(*histograms[histogram], percentiles[percentile]);
             
-        }while(wasProcessRemoved == true);
+            //Hole counts are not memory
+            if(histogram != 1)
+            figures[figure] *= granularity;
+        }
+    }
+    
+    isDefined[34] = granularity > 1;
+    figures[34] = metrics.granularityWaste;
+}
+
+// What-if mode: every simulation branches from checkpoint (checked beforehand) instead of starting empty
+void runSweepSimulation(const SweepSimulation &simulation, const vector<Process> &processes, const SimulationOptions &options, const MappedFile *checkpoint, Metrics &metrics){
+    ArrivalStream arrivals;
+    openSharedArrivalStream(processes, arrivals);
+    
+    CPU processor;
+    int firstTime = 1;
+    
+    if(checkpoint != NULL){
+        CheckpointHeader header;
+        memcpy(&header, checkpoint->data, sizeof(header));
+        restoreCheckpointState(*checkpoint, header, simulation.algorithm, simulation.totalMemory / options.granularity, options, processor, metrics);
         
+        arrivals.chunkPosition = header.consumedArrivals;
+        arrivals.consumedArrivals = header.consumedArrivals;
+        firstTime = header.resumeTime;
+    }
+    else{
+        initializeMetrics(metrics);
+        metrics.totalProcesses = arrivals.totalProcesses;
+        initializeMemory(processor, simulation.totalMemory / options.granularity, options.granularity);
+    }
+    
+    simulateArrivalsUsingAlgorithm(simulation.algorithm, arrivals, processor, metrics, NULL, options, firstTime);
+    closeArrivalStream(arrivals);
+    finalizeMetrics(metrics, processor, processor.totalMemory);
+}
+
+// Takes the next simulation of its own queue or, when it is empty, steals the oldest one of another queue
+int takeSweepSimulation(vector<SweepWorkerQueue> &queues, int worker){
+    {
+        lock_guard<mutex> guard(queues[worker].lock);
+        if(!queues[worker].simulations.empty()){
+            int simulation = queues[worker].simulations.back();
+            queues[worker].simulations.pop_back();
+            return simulation;
+        }
+    }
+    
+    for(size_t offset = 1; offset < queues.size(); offset++){
+        SweepWorkerQueue &victim = queues[(worker + offset) % queues.size()];
+        lock_guard<mutex> guard(victim.lock);
         
-        //Relocate the original processes
-        while(!processes.empty() && (int)processes[0].arrivalTime == currentTime){		
-            int bestHoleIndex = -1;
-            int memoryDifference = -1;
-            
-            // Check if there's a good hole for the 1st process in the queue
-            for(int i=0; i < (int) processor.runningProcesses.size(); i++){
-                
-                //If the first element of the processes vector fits in a hole
-                if(processor.runningProcesses[i].name.compare("hole") == 0 && processes[0].memoryRequirement <= processor.runningProcesses[i].memoryRequirement){
-                    if(memoryDifference > processor.runningProcesses[i].memoryRequirement - processes[0].memoryRequirement || memoryDifference == -1){
-                        bestHoleIndex = i;
-                        memoryDifference = processor.runningProcesses[i].memoryRequirement - processes[0].memoryRequirement;	
-                    }   		
-                }
+        if(!victim.simulations.empty()){
+            int simulation = victim.simulations.front();
+            victim.simulations.pop_front();
+            return simulation;
+        }
+    }
+    
+    //No simulations are added once the sweep starts, so every queue is empty for good
+    return -1;
+}
+
+void runSweepWorker(int worker, vector<SweepWorkerQueue> *queues, const vector<SweepSimulation> *simulations, const vector<vector<Process> > *traces, const SimulationOptions *options, const MappedFile *checkpoint, vector<Metrics> *results){
+    for(int simulation = takeSweepSimulation(*queues, worker); simulation != -1; simulation = takeSweepSimulation(*queues, worker)){
+        const SweepSimulation &current = (*simulations)[simulation];
+        runSweepSimulation(current, (*traces)[current.trace], *options, checkpoint, (*results)[simulation]);
+    }
+}
+
+void writeSweepTable(const SweepOptions &sweep, const vector<SweepSimulation> &simulations, const vector<Metrics> &results, uint64_t granularity, ostream &table){
+    double figures[SWEEP_FIGURE_COUNT];
+    bool isDefined[SWEEP_FIGURE_COUNT];
+    
+    //Enough digits to keep the integer figures (e.g. waiting time) out of scientific notation
+    table.precision(12);
+    
+    if(sweep.useJsonFormat)
+    table << "[" << endl;
+    else{
+        table << "trace,memory,algorithm";
+        for(int i = 0; i < SWEEP_FIGURE_COUNT; i++)
+        table << "," << SWEEP_FIGURE_NAMES[i];
+        table << endl;
+    }
+    
+    for(size_t simulation = 0; simulation < simulations.size(); simulation++){
+        const SweepSimulation &current = simulations[simulation];
+        const string &traceFileName = sweep.traceFileNames[current.trace];
+        const char *algorithmName = ALGORITHM_DESCRIPTIONS[current.algorithm];
+        computeSweepFigures(results[simulation], current.totalMemory / granularity, granularity, figures, isDefined);
+        
+        if(sweep.useJsonFormat){
+            table << "  {\"trace\": \"";
+            for(size_t i = 0; i < traceFileName.size(); i++){
+                if(traceFileName[i] == '"' || traceFileName[i] == '\\')
+                table << '\\';
+                table << traceFileName[i];
             }
+            table << "\", \"memory\": " << current.totalMemory << ", \"algorithm\": \"" << algorithmName << "\"";
             
-            //If it doesn't fit in any hole
-            if(bestHoleIndex == -1){
-                //If it doesn't fit in any hole, add to queue
-                processor.queue.push_back(processes[0]);
-                metrics.allocationFailures++;
-            }
-            else{
-                //If it fits exactly, simply swap the values
-                if( memoryDifference == 0){
-                    swap(processor.runningProcesses[bestHoleIndex], processes[0]);
-                }
-                
-                //Otherwise we need to create a new hole with the remaining memory
-                else{
-                    //Move all processes one position to the right and create the remaining hole
-                    insertMemoryHoleAfterIndex(processor, bestHoleIndex, memoryDifference);
-                    //Insert the process that fits
-                    swap(processor.runningProcesses[bestHoleIndex], processes[0]);
-                    //TODO hole checker: if there are several consecutive holes we should merge them 
-                    mergeAdjacentMemoryHoles(processor.runningProcesses);
-                }
-                metrics.successfulAllocations++;
+            for(int i = 0; i < SWEEP_FIGURE_COUNT; i++){
+                table << ", \"" << SWEEP_FIGURE_NAMES[i] << "\": ";
+                if(isDefined[i])
+                table << figures[i];
+                else
+                table << "null";
             }
+            table << (simulation + 1 < simulations.size() ? "}," : "}") << endl;
+        }
+        else{
+            //Trace names are quoted, doubling the quotes they contain
+            table << "\"";
+            for(size_t i = 0; i < traceFileName.size(); i++)
+            table << (traceFileName[i] == '"' ? "\"\"" : string(1, traceFileName[i]));
+            table << "\"," << current.totalMemory << "," << algorithmName;
             
-            processes.erase(processes.begin()); 			    	
-        }		
-        
-        //We need to take into account the memory positions occupied by previous processes
-        int startPosition = 0;
-        
-        //Print running processes at this time instant to file only
-        for(int i = 0; i < (int)processor.runningProcesses.size(); i++){
-            
-            file_exported << "[" << startPosition << " " 
-            << processor.runningProcesses[i].name << " " 
-            << processor.runningProcesses[i].memoryRequirement << "] ";
-            
-            startPosition += processor.runningProcesses[i].memoryRequirement;
-        }       
-        file_exported << endl;
-        
-        // Update metrics for this time step
-        updateMetrics(metrics, processor, currentTime, totalMemory);
-        
-        shouldContinueExecution = shouldContinueSimulation(processor.queue, processor.runningProcesses, totalMemory);
-        decreaseProcessesTimeUnitsAndConvertFinishedIntoHoles(processor.runningProcesses, metrics);
-        mergeAdjacentMemoryHoles(processor.runningProcesses);
-        
-        metrics.totalSimulationTime = currentTime;
-        
+            for(int i = 0; i < SWEEP_FIGURE_COUNT; i++){
+                table << ",";
+                if(isDefined[i])
+                table << figures[i];
+            }
+            table << endl;
+        }
     }
     
-    file_exported.close();
+    if(sweep.useJsonFormat)
+    table << "]" << endl;
+}
+
+// Checks that every variant of a what-if sweep can branch from the checkpoint, which is left mapped for
+// the simulations. Returns false (after reporting it) otherwise.
+bool openWhatIfCheckpoint(const SweepOptions &sweep, const vector<Process> &processes, const SimulationOptions &options, MappedFile &checkpoint){
+    CheckpointHeader header;
+    struct stat traceStatus;
+    
+    if(!openCheckpoint(options.restoreFileName, checkpoint, header))
+    return false;
+    
+    bool canBranch = stat(sweep.traceFileNames[0].c_str(), &traceStatus) == 0 && (uint64_t)traceStatus.st_size == header.traceSize && processes.size() == header.totalProcesses;
+    if(!canBranch)
+    cout << "Error: '" << sweep.traceFileNames[0] << "' is not the trace the checkpoint was taken from." << endl;
+    
+    for(size_t memory = 0; canBranch && memory < sweep.memorySizes.size(); memory++){
+        for(size_t algorithm = 0; canBranch && algorithm < sweep.algorithms.size(); algorithm++)
+        canBranch = canBranchCheckpoint(header, sweep.algorithms[algorithm], sweep.memorySizes[memory] / options.granularity, options);
     }
-    else
+    
+    //The simulations take the checkpoint as valid, so it is read through once here
+    CPU processor;
+    Metrics metrics;
+    if(canBranch)
+    canBranch = restoreCheckpointState(checkpoint, header, header.algorithm, header.totalMemory, options, processor, metrics);
+    
+    if(!canBranch){
+        unmapFile(checkpoint);
+        return false;
+    }
+    
+    cout << "Branching from the checkpoint " << options.restoreFileName << " at time unit " << header.resumeTime << endl;
+    return true;
+}
+
+void runSweep(const SweepOptions &sweep, const SimulationOptions &options){
+    //Every trace is read and sorted only once
+    vector<vector<Process> > traces(sweep.traceFileNames.size());
+    
+    for(size_t trace = 0; trace < sweep.traceFileNames.size(); trace++){
+        if(!loadSortedArrivals(sweep.traceFileNames[trace], options, traces[trace]))
+        return;
+    }
+    
+    //What-if mode: a single trace, resumed from a checkpoint
+    MappedFile checkpoint;
+    bool isWhatIf = !options.restoreFileName.empty();
+    
+    if(isWhatIf && !openWhatIfCheckpoint(sweep, traces[0], options, checkpoint))
+    return;
+    
+    vector<SweepSimulation> simulations;
+    for(size_t trace = 0; trace < sweep.traceFileNames.size(); trace++){
+        for(size_t memory = 0; memory < sweep.memorySizes.size(); memory++){
+            for(size_t algorithm = 0; algorithm < sweep.algorithms.size(); algorithm++){
+                SweepSimulation simulation;
+                simulation.trace = trace;
+                simulation.totalMemory = sweep.memorySizes[memory];
+                simulation.algorithm = sweep.algorithms[algorithm];
+                simulations.push_back(simulation);
+            }
+        }
+    }
+    
+    unsigned int threadCount = sweep.threadCount;
+    if(threadCount == 0)
+    threadCount = max(1u, thread::hardware_concurrency());
+    threadCount = min(threadCount, (unsigned int)simulations.size());
+    
+    //Consecutive simulations go to the same thread, so stealing takes them from the other end
+    vector<SweepWorkerQueue> queues(threadCount);
+    for(size_t simulation = 0; simulation < simulations.size(); simulation++)
+    queues[simulation * threadCount / simulations.size()].simulations.push_back(simulation);
+    
+    cout << "Sweep of " << simulations.size() << " simulations on " << threadCount << " threads" << endl;
+    
+    vector<Metrics> results(simulations.size());
+    vector<thread> workers;
+    
+    for(unsigned int worker = 1; worker < threadCount; worker++)
+    workers.push_back(thread(runSweepWorker, worker, &queues, &simulations, &traces, &options, isWhatIf ? &checkpoint : NULL, &results));
+    
+    //The main thread works too
+    runSweepWorker(0, &queues, &simulations, &traces, &options, isWhatIf ? &checkpoint : NULL, &results);
+    
+    for(size_t worker = 0; worker < workers.size(); worker++)
+    workers[worker].join();
+    
+    if(isWhatIf)
+    unmapFile(checkpoint);
+    
+    ofstream table(sweep.tableFileName.c_str());
+    if(!table){
         cout << "The output file could not be created" << endl;
+        return;
+    }
     
-    // Finalize and print metrics
-    finalizeMetrics(metrics, processor, totalMemory);
-    printMetrics(metrics, totalMemory, "BEST FIT");
+    writeSweepTable(sweep, simulations, results, options.granularity, table);
+    cout << "Sweep table written to " << sweep.tableFileName << endl;
+}
+
+// Bank router given by its command (e.g. "least-loaded"), -1 if there is none
+int findBankRouter(const char *command){
+    for(int router = 0; router < BANK_ROUTER_COUNT; router++){
+        if(strcmp(command, BANK_ROUTER_COMMANDS[router]) == 0)
+        return router;
+    }
     
-    cout << "Algorithm finished" << endl;
+    return -1;
+}
 
+// Algorithm selected by a command such as "f" (first fit). Returns -1 if it is unknown.
+int findAlgorithm(const char *command){
+    for(int algorithm = 0; algorithm < ALGORITHM_COUNT; algorithm++){
+        if(strcmp(command, ALGORITHM_COMMANDS[algorithm]) == 0)
+        return algorithm;
+    }
+    
+    return -1;
 }
 
-int argumentValidation(int argc, char *argv[], string &importFileName, string &exportFileName, int &totalMemory, bool &useFirstFitAlgorithm, bool &useBestFitAlgorithm){
+int argumentValidation(int argc, char *argv[], string &importFileName, string &exportFileName, uint64_t &totalMemory, int &algorithm, SimulationOptions &options){
     
     int error = -1;
 
@@ -641,44 +5196,266 @@ int argumentValidation(int argc, char *argv[], string &importFileName, string &e
             
             //Third argument -> total memory size
             case 3:
-                if(atoi(argv[i]) < 0)
+                if(!parseMemorySize(argv[i], totalMemory))
                     error = 1;
-
-                totalMemory = atoi(argv[i]);
             break;
 
             //Fourth argument -> selected algorithm
             case 4:
-                //First fit algorithm
-                if(strcmp(argv[i], "-f") == 0)
-                    useFirstFitAlgorithm = true;
+                //-f first fit, -b best fit, -n next fit, -w worst fit
+                if(argv[i][0] == '-')
+                    algorithm = findAlgorithm(argv[i] + 1);
 
-                //Best fit algorithm
-                else if(strcmp(argv[i], "-b") == 0)
-                    useBestFitAlgorithm = true;
-
-                else
+                if(argv[i][0] != '-' || algorithm == -1)
                     error = 2;
             break;
+            
+            //Optional arguments -> checkpoints and simulation options
+            default:
+                if(strcmp(argv[i], "--checkpoint-every") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+                    options.checkpointInterval = atoi(argv[++i]);
+                
+                else if(strcmp(argv[i], "--checkpoint-prefix") == 0 && i + 1 < argc)
+                    options.checkpointPrefix = argv[++i];
+                
+                else if(strcmp(argv[i], "--restore") == 0 && i + 1 < argc)
+                    options.restoreFileName = argv[++i];
+                
+                //Independent memory banks and the router that assigns the arrivals to them
+                else if(strcmp(argv[i], "--banks") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+                    options.bankCount = atoi(argv[++i]);
+                
+                else if(strcmp(argv[i], "--bank-router") == 0 && i + 1 < argc && findBankRouter(argv[i + 1]) != -1)
+                    options.bankRouter = findBankRouter(argv[++i]);
+                
+                //Arrivals read from a pipe as they come
+                else if(strcmp(argv[i], "--stream") == 0)
+                    options.streamArrivals = true;
+                
+                else if(strcmp(argv[i], "--stream-metrics-every") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+                    options.streamMetricsEvery = atoi(argv[++i]);
+                
+                else if(!parseSimulationOption(argc, argv, i, options))
+                    error = 3;
+            break;
         }
     }
+    
+    //Every bank needs some memory, and a checkpoint holds a single memory map
+    if(error == -1 && options.bankCount > 1 && (totalMemory / options.granularity < options.bankCount || options.checkpointInterval != 0 || !options.restoreFileName.empty()))
+        error = 4;
+    
+    //A pipe cannot be read again from a checkpoint
+    if(error == -1 && options.streamArrivals && (options.bankCount > 1 || options.checkpointInterval != 0 || !options.restoreFileName.empty()))
+        error = 5;
+    
     return error;
 }
 
+// Splits a comma separated argument such as "1000,2000,4000"
+void splitArgumentList(const char *argument, vector<string> &items){
+    items.clear();
+    string item;
+    
+    for(const char *character = argument; ; character++){
+        if(*character == ',' || *character == '\0'){
+            items.push_back(item);
+            item.clear();
+            
+            if(*character == '\0')
+            break;
+        }
+        else
+        item += *character;
+    }
+}
+
+// --sweep <table file> <memory sizes> <algorithms> <trace> [<trace> ...] [options]
+int sweepArgumentValidation(int argc, char *argv[], SweepOptions &sweep, SimulationOptions &options){
+    vector<string> items;
+    
+    sweep.tableFileName = argv[2];
+    sweep.threadCount = 0;
+    sweep.useJsonFormat = false;
+    
+    //Memory sizes, e.g. 1000,2000,4000
+    splitArgumentList(argv[3], items);
+    for(size_t i = 0; i < items.size(); i++){
+        uint64_t memorySize;
+        if(!parseMemorySize(items[i].c_str(), memorySize) || memorySize == 0)
+        return 1;
+        
+        sweep.memorySizes.push_back(memorySize);
+    }
+    
+    //Algorithms, e.g. f,b,n,w
+    splitArgumentList(argv[4], items);
+    for(size_t i = 0; i < items.size(); i++){
+        int algorithm = findAlgorithm(items[i].c_str());
+        if(algorithm == -1)
+        return 2;
+        
+        sweep.algorithms.push_back(algorithm);
+    }
+    
+    int i = 5;
+    for(; i < argc && strncmp(argv[i], "--", 2) != 0; i++)
+    sweep.traceFileNames.push_back(argv[i]);
+    
+    if(sweep.traceFileNames.empty())
+    return 4;
+    
+    for(; i < argc; i++){
+        if(strcmp(argv[i], "--threads") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        sweep.threadCount = atoi(argv[++i]);
+        
+        else if(strcmp(argv[i], "--format") == 0 && i + 1 < argc && (strcmp(argv[i + 1], "csv") == 0 || strcmp(argv[i + 1], "json") == 0))
+        sweep.useJsonFormat = strcmp(argv[++i], "json") == 0;
+        
+        else if(!parseSimulationOption(argc, argv, i, options))
+        return 3;
+    }
+    
+    //Every memory size must hold at least one granule
+    for(size_t memory = 0; memory < sweep.memorySizes.size(); memory++){
+        if(sweep.memorySizes[memory] < options.granularity)
+        return 1;
+    }
+    
+    return -1;
+}
+
+// Distribution given by its command (e.g. "lognormal"), -1 if there is none
+int findDistribution(const char *command){
+    for(int distribution = 0; distribution < DISTRIBUTION_COUNT; distribution++){
+        if(strcmp(command, DISTRIBUTION_COMMANDS[distribution]) == 0)
+        return distribution;
+    }
+    
+    return -1;
+}
+
+// --generate <trace> <processes> [options]. Returns -1 if they are right, 1 for a wrong option and 2 for wrong ranges.
+int generateArgumentValidation(int argc, char *argv[], WorkloadOptions &workload){
+    initializeWorkloadOptions(workload);
+    workload.traceFileName = argv[2];
+    workload.processCount = strtoull(argv[3], NULL, 10);
+    
+    for(int i = 4; i < argc; i++){
+        if(strcmp(argv[i], "--seed") == 0 && i + 1 < argc)
+        workload.seed = strtoull(argv[++i], NULL, 10);
+        
+        else if(strcmp(argv[i], "--arrivals") == 0 && i + 1 < argc && (strcmp(argv[i + 1], "poisson") == 0 || strcmp(argv[i + 1], "bursty") == 0))
+        workload.arrivalPattern = strcmp(argv[++i], "bursty") == 0 ? BURSTY_ARRIVALS : POISSON_ARRIVALS;
+        
+        else if(strcmp(argv[i], "--arrival-rate") == 0 && i + 1 < argc && atof(argv[i + 1]) > 0)
+        workload.arrivalRate = atof(argv[++i]);
+        
+        else if(strcmp(argv[i], "--burst-size") == 0 && i + 1 < argc && atof(argv[i + 1]) >= 1)
+        workload.burstSize = atof(argv[++i]);
+        
+        else if(strcmp(argv[i], "--sizes") == 0 && i + 1 < argc && findDistribution(argv[i + 1]) != -1)
+        workload.sizeDistribution = findDistribution(argv[++i]);
+        
+        else if(strcmp(argv[i], "--size-range") == 0 && i + 2 < argc && parseMemorySize(argv[i + 1], workload.minimumSize) && parseMemorySize(argv[i + 2], workload.maximumSize)
+        && workload.minimumSize > 0)
+        i += 2;
+        
+        else if(strcmp(argv[i], "--times") == 0 && i + 1 < argc && findDistribution(argv[i + 1]) != -1)
+        workload.timeDistribution = findDistribution(argv[++i]);
+        
+        else if(strcmp(argv[i], "--time-range") == 0 && i + 2 < argc && atoi(argv[i + 1]) > 0 && atoi(argv[i + 2]) > 0){
+            workload.minimumTime = atoi(argv[++i]);
+            workload.maximumTime = atoi(argv[++i]);
+        }
+        
+        else
+        return 1;
+    }
+    
+    if(workload.processCount == 0 || workload.minimumSize > workload.maximumSize || workload.minimumTime > workload.maximumTime)
+    return 2;
+    
+    return -1;
+}
+
 int main(int argc, char *argv[]){
         
         string importFileName = "";
         string exportFileName = "";
-        int totalMemory = 0;
-        bool useFirstFitAlgorithm = false, useBestFitAlgorithm = false;
+        uint64_t totalMemory = 0;
+        int algorithm = -1;
+        SimulationOptions options;
+        initializeSimulationOptions(options);
         
         //ARGUMENT CONTROL
-        if(argc !=5){
+        //Trace conversion: --convert <text trace> <binary trace>
+        if(argc == 4 && strcmp(argv[1], "--convert") == 0){
+            if(!convertTextTraceToBinary(argv[2], argv[3]))
+            return 1;
+        }
+        //Workload generator: --generate <trace> <processes> [options]
+        else if(argc >= 4 && strcmp(argv[1], "--generate") == 0){
+            WorkloadOptions workload;
+            int error = generateArgumentValidation(argc, argv, workload);
+            
+            if(error == -1)
+            generateWorkload(workload);
+            
+            else if(error == 1)
+            cout << "An unknown workload option has been entered." << endl;
+            
+            else
+            cout << "The number of processes must be positive and every range must go from its minimum to its maximum." << endl;
+        }
+        //Parameter sweep: --sweep <table file> <memory sizes> <algorithms> <trace> [<trace> ...] [options]
+        else if(argc >= 6 && strcmp(argv[1], "--sweep") == 0){
+            SweepOptions sweep;
+            int error = sweepArgumentValidation(argc, argv, sweep, options);
+            
+            if(error == -1)
+            runSweep(sweep, options);
+            
+            else if(error == 1)
+            cout << "The memory sizes of the sweep must hold at least one granule." << endl;
+            
+            else if(error == 2)
+            cout << "The algorithm command entered is incorrect." << endl;
+            
+            else if(error == 3)
+            cout << "An unknown simulation option has been entered." << endl;
+            
+            else
+            cout << "You have entered the arguments incorrectly." << endl;
+        }
+        //What-if: --what-if <checkpoint> <table file> <memory sizes> <algorithms> <trace> [options], parsed
+        //as a sweep whose arguments start one position later
+        else if(argc >= 7 && strcmp(argv[1], "--what-if") == 0){
+            SweepOptions sweep;
+            int error = sweepArgumentValidation(argc - 1, argv + 1, sweep, options);
+            options.restoreFileName = argv[2];
+            
+            if(error == -1 && sweep.traceFileNames.size() == 1)
+            runSweep(sweep, options);
+            
+            else if(error == 1)
+            cout << "The memory sizes of the sweep must hold at least one granule." << endl;
+            
+            else if(error == 2)
+            cout << "The algorithm command entered is incorrect." << endl;
+            
+            else if(error == 3)
+            cout << "An unknown simulation option has been entered." << endl;
+            
+            else
+            cout << "You have entered the arguments incorrectly: a what-if takes the trace of its checkpoint only." << endl;
+        }
+        else if(argc < 5){
             cout << "You have entered the arguments incorrectly." << endl;
             
         }
         else{
-            int error = argumentValidation(argc, argv, importFileName, exportFileName, totalMemory, useFirstFitAlgorithm, useBestFitAlgorithm);
+            int error = argumentValidation(argc, argv, importFileName, exportFileName, totalMemory, algorithm, options);
             //If errors are detected in the arguments, errors are shown and the program is terminated
             if(error == -1){
                 cout << "Selected input file: " << importFileName << endl 
@@ -686,22 +5463,34 @@ int main(int argc, char *argv[]){
                 << "Maximum processor capacity: " << totalMemory << endl
                 << "=========================================================" << endl;
                 
-                if(useFirstFitAlgorithm == true){
-                    cout << "You have selected the first fit algorithm" << endl;
-                    allocateProcessesUsingFirstFit(totalMemory, importFileName, exportFileName);
-                }
-                else{
-                    cout << "You have selected the best fit algorithm" << endl;
-                    allocateProcessesUsingBestFit(totalMemory, importFileName, exportFileName);
-                }
+                cout << "You have selected the " << ALGORITHM_DESCRIPTIONS[algorithm] << " algorithm" << endl;
+                
+                //The simulation counts whole granules, and what is left of the last one is not used
+                uint64_t totalGranules = totalMemory / options.granularity;
+                
+                if(options.bankCount > 1)
+                allocateProcessesToBanks(totalGranules, importFileName, exportFileName, algorithm, options);
+                else if(options.streamArrivals)
+                streamProcesses(totalGranules, importFileName, exportFileName, algorithm, options);
+                else
+                allocateProcesses(totalGranules, importFileName, exportFileName, algorithm, options);
             }
             
             else if(error == 1)
-            cout << "The memory size entered as argument is negative." << endl;
+            cout << "The memory size entered as argument is not a valid number." << endl;
             
             else if(error == 2)
             cout << "The algorithm command entered is incorrect." << endl;
             
+            else if(error == 3)
+            cout << "An unknown simulation option has been entered." << endl;
+            
+            else if(error == 4)
+            cout << "Every memory bank needs at least one memory unit, and checkpoints are not available with several banks." << endl;
+            
+            else if(error == 5)
+            cout << "The streaming mode works with a single memory and without checkpoints." << endl;
+            
             else
             cout << "Unexpected errors have occurred with the arguments" << endl;
             
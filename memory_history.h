@@ -0,0 +1,90 @@
+#ifndef MEMORY_HISTORY_H
+#define MEMORY_HISTORY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary memory map history: what the simulator dumps with --output-format binary instead of the text
+// memory map, and what the history decoder reads. Shared by both, header only.
+//
+// The file starts with a HistoryHeader and then has one record per written time instant:
+//   keyframe: HISTORY_KEYFRAME, time, segment count, and every segment of the memory map
+//   delta:    HISTORY_DELTA, time minus the time of the previous record, event count, and the events
+// Every value is a varint (7 bits per byte, least significant first). An event is the new state of an
+// address range: (gap << HISTORY_EVENT_KIND_BITS | kind), size, and for HISTORY_ASSIGN the name length
+// and its characters. The gap is the distance from the end of the previous event of the record (from
+// address 0 for the first one). The events of a record are in address order and cover every segment
+// that changed since the previous record, so applying one replaces the segments that overlap its range.
+// Addresses and sizes are in memory units, like the text dump, whatever the granularity of the simulation.
+// A keyframe lists its segments the same way, so it can be read without anything written before.
+//
+// After the last record come the index, one HistoryIndexEntry per keyframe in time order, and a
+// HistoryFooter at the very end of the file. The first record is always a keyframe, and there is one
+// every keyframeEvery records, so any time instant is rebuilt from the keyframe before it.
+
+const char HISTORY_MAGIC[8] = {'M', 'M', 'H', 'I', 'S', 'T', '0', '1'};
+const char HISTORY_INDEX_MAGIC[8] = {'M', 'M', 'H', 'I', 'N', 'D', 'X', '1'};
+
+const unsigned char HISTORY_KEYFRAME = 'K';
+const unsigned char HISTORY_DELTA = 'D';
+
+// Kind of an event. The decoder only tells processes from holes, the rest says why the hole is there.
+const uint32_t HISTORY_ASSIGN = 0;  // A process takes the range
+const uint32_t HISTORY_FREE = 1;    // The process that had exactly this range finished
+const uint32_t HISTORY_MERGE = 2;   // A hole replaces several segments
+const uint32_t HISTORY_SPLIT = 3;   // A hole is what is left of a bigger hole
+const int HISTORY_EVENT_KIND_BITS = 2;
+const int HISTORY_EVENT_KIND_COUNT = 4;
+
+const uint32_t HISTORY_DEFAULT_KEYFRAME_EVERY = 1024;
+
+struct HistoryHeader{
+    char magic[8];
+    uint32_t keyframeEvery; // Records between keyframes
+    uint32_t reserved;
+};
+
+struct HistoryIndexEntry{
+    uint64_t time;
+    uint64_t offset;        // Of the keyframe record, from the start of the file
+};
+
+struct HistoryFooter{
+    uint64_t indexOffset;
+    uint64_t keyframeCount;
+    uint64_t recordCount;
+    char magic[8];
+};
+
+// Writes value into bytes (at least 10 of them), returning how many were used
+inline size_t encodeHistoryVarint(uint64_t value, unsigned char *bytes){
+    size_t length = 0;
+    
+    while(value >= 0x80){
+        bytes[length++] = (unsigned char)(value | 0x80);
+        value >>= 7;
+    }
+    bytes[length++] = (unsigned char)value;
+    
+    return length;
+}
+
+// Reads a value at position, moving it past the value. False if the bytes end before the value does.
+inline bool decodeHistoryVarint(const unsigned char *&position, const unsigned char *end, uint64_t &value){
+    value = 0;
+    
+    for(int shift = 0; shift < 64; shift += 7){
+        if(position == end)
+        return false;
+        
+        unsigned char byte = *position++;
+        value |= (uint64_t)(byte & 0x7f) << shift;
+        
+        if((byte & 0x80) == 0)
+        return true;
+    }
+    
+    return false;
+}
+
+#endif
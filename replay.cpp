@@ -0,0 +1,258 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <queue>
+#include <algorithm>
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#include "arena_allocator.h"
+
+using namespace std;
+
+// Replay driver: runs a trace in the format of input-example.txt against the arena allocator, with
+// every placement and header layout, and against malloc. Every process is allocated at its arrival
+// time and freed when it finishes, as in the simulator (a process that does not fit is dropped instead
+// of waiting), and the time of every allocate and free call is measured to report its percentiles. Failed
+// allocations are timed too, as a failed search is the slowest one, so every row covers the same requests.
+
+struct ReplayProcess{
+    unsigned int arrivalTime;
+    size_t size;            // Bytes
+    unsigned int executionTime;
+};
+
+struct ReplayOptions{
+    string traceFileName;
+    size_t arenaSize;       // Bytes
+    size_t unitBytes;       // Bytes per memory unit of the trace
+    size_t alignment;
+};
+
+struct ReplayResult{
+    string allocatorName;
+    size_t requests;
+    size_t allocations;
+    size_t failures;
+    size_t peakAllocatedBytes; // Usable bytes in use at the peak, arena only
+    vector<uint32_t> allocateNanoseconds;       // Every allocate call, failed or not
+    vector<uint32_t> failedAllocateNanoseconds; // Only the failed ones
+    vector<uint32_t> freeNanoseconds;
+};
+
+bool orderByArrivalTime(const ReplayProcess &first, const ReplayProcess &second){
+    return first.arrivalTime < second.arrivalTime;
+}
+
+// Reads "<name> <arrival time> <memory> <execution time>" lines, sorted by arrival time afterwards
+bool readReplayTrace(const ReplayOptions &replay, vector<ReplayProcess> &processes){
+    ifstream trace(replay.traceFileName.c_str());
+    
+    if(!trace){
+        cout << "The trace could not be opened" << endl;
+        return false;
+    }
+    
+    string name;
+    unsigned int arrivalTime, memoryRequirement, executionTime;
+    
+    while(trace >> name >> arrivalTime >> memoryRequirement >> executionTime){
+        ReplayProcess process;
+        process.arrivalTime = arrivalTime;
+        process.size = (size_t)memoryRequirement * replay.unitBytes;
+        process.executionTime = executionTime;
+        processes.push_back(process);
+    }
+    
+    stable_sort(processes.begin(), processes.end(), orderByArrivalTime);
+    return true;
+}
+
+uint32_t elapsedNanoseconds(chrono::steady_clock::time_point start){
+    return (uint32_t)chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+}
+
+void *replayAllocate(ArenaAllocator *arena, size_t size){
+    return arena != NULL ? arenaAllocate(*arena, size) : malloc(size);
+}
+
+void replayFree(ArenaAllocator *arena, void *pointer){
+    if(arena != NULL)
+    arenaFree(*arena, pointer);
+    else
+    free(pointer);
+}
+
+// Replays the trace on the arena, or on malloc if it is NULL. Processes finished by a time unit are
+// freed before the ones arriving in it are allocated.
+void replayTrace(const vector<ReplayProcess> &processes, ArenaAllocator *arena, ReplayResult &result){
+    priority_queue<pair<unsigned long long, size_t>, vector<pair<unsigned long long, size_t> >, greater<pair<unsigned long long, size_t> > > completions;
+    vector<void *> pointers(processes.size(), (void *)NULL);
+    
+    result.requests = processes.size();
+    result.allocations = 0;
+    result.failures = 0;
+    result.peakAllocatedBytes = 0;
+    result.allocateNanoseconds.clear();
+    result.failedAllocateNanoseconds.clear();
+    result.freeNanoseconds.clear();
+    result.allocateNanoseconds.reserve(processes.size());
+    result.freeNanoseconds.reserve(processes.size());
+    
+    for(size_t i = 0; i <= processes.size(); i++){
+        //After the last arrival, every process left finishes
+        unsigned long long currentTime = i < processes.size() ? processes[i].arrivalTime : ~0ull;
+        
+        while(!completions.empty() && completions.top().first <= currentTime){
+            size_t finished = completions.top().second;
+            completions.pop();
+            
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            replayFree(arena, pointers[finished]);
+            result.freeNanoseconds.push_back(elapsedNanoseconds(start));
+        }
+        
+        if(i == processes.size())
+        break;
+        
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        pointers[i] = replayAllocate(arena, processes[i].size);
+        uint32_t nanoseconds = elapsedNanoseconds(start);
+        result.allocateNanoseconds.push_back(nanoseconds);
+        
+        if(pointers[i] == NULL){
+            result.failures++;
+            result.failedAllocateNanoseconds.push_back(nanoseconds);
+            continue;
+        }
+        
+        result.allocations++;
+        completions.push(make_pair((unsigned long long)processes[i].arrivalTime + processes[i].executionTime, i));
+        
+        if(arena != NULL && arena->allocatedBytes > result.peakAllocatedBytes)
+        result.peakAllocatedBytes = arena->allocatedBytes;
+    }
+}
+
+// Value below which the given fraction of the times falls
+uint32_t latencyPercentile(vector<uint32_t> &nanoseconds, double fraction){
+    if(nanoseconds.empty())
+    return 0;
+    
+    size_t position = (size_t)(fraction * (nanoseconds.size() - 1));
+    nth_element(nanoseconds.begin(), nanoseconds.begin() + position, nanoseconds.end());
+    return nanoseconds[position];
+}
+
+void printLatencies(const char *call, vector<uint32_t> &nanoseconds){
+    cout << call << " latency p50/p90/p99/p99.9/max (ns): " << latencyPercentile(nanoseconds, 0.5) << " / " << latencyPercentile(nanoseconds, 0.9)
+    << " / " << latencyPercentile(nanoseconds, 0.99) << " / " << latencyPercentile(nanoseconds, 0.999) << " / " << latencyPercentile(nanoseconds, 1) << endl;
+}
+
+void printReplayResult(ReplayResult &result, size_t arenaSize){
+    cout << "========== " << result.allocatorName << " ==========" << endl;
+    cout << "Successful Allocations: " << result.allocations << "/" << result.requests << " requests" << endl;
+    cout << "Allocation Failures: " << result.failures << endl;
+    
+    if(arenaSize != 0)
+    cout << "Peak Allocated Memory: " << result.peakAllocatedBytes << "/" << arenaSize << " bytes (" << (double)result.peakAllocatedBytes / arenaSize * 100 << "%)" << endl;
+    
+    printLatencies("Allocate", result.allocateNanoseconds);
+    if(!result.failedAllocateNanoseconds.empty())
+    printLatencies("Failed allocate", result.failedAllocateNanoseconds);
+    printLatencies("Free", result.freeNanoseconds);
+    cout << "=========================================================\n" << endl;
+}
+
+bool runReplay(const ReplayOptions &replay){
+    vector<ReplayProcess> processes;
+    
+    if(!readReplayTrace(replay, processes))
+    return false;
+    
+    cout << "Replaying " << processes.size() << " processes from " << replay.traceFileName << endl;
+    cout << "=========================================================\n" << endl;
+    
+    const int placements[2] = {ARENA_FIRST_FIT, ARENA_BEST_FIT};
+    const char *const placementNames[2] = {"FIRST FIT", "BEST FIT"};
+    const int headers[2] = {ARENA_IN_BAND_HEADERS, ARENA_SIDE_TABLE_HEADERS};
+    const char *const headerNames[2] = {"IN-BAND HEADERS", "SIDE TABLE"};
+    ReplayResult result;
+    
+    for(int placement = 0; placement < 2; placement++){
+        for(int header = 0; header < 2; header++){
+            ArenaOptions options;
+            ArenaAllocator arena;
+            
+            initializeArenaOptions(options);
+            options.placement = placements[placement];
+            options.headers = headers[header];
+            options.alignment = replay.alignment;
+            
+            if(!createArena(arena, replay.arenaSize, options)){
+                cout << "The arena could not be created" << endl;
+                return false;
+            }
+            
+            result.allocatorName = string("ARENA ") + placementNames[placement] + ", " + headerNames[header];
+            replayTrace(processes, &arena, result);
+            printReplayResult(result, replay.arenaSize);
+            destroyArena(arena);
+        }
+    }
+    
+    result.allocatorName = "MALLOC";
+    replayTrace(processes, NULL, result);
+    printReplayResult(result, 0);
+    
+    return true;
+}
+
+// Returns -1 if the arguments are right, 1 for a wrong arena size or alignment and 2 for an unknown option
+int replayArgumentValidation(int argc, char *argv[], ReplayOptions &replay){
+    replay.traceFileName = argv[1];
+    replay.arenaSize = strtoull(argv[2], NULL, 10);
+    replay.unitBytes = 1;
+    replay.alignment = 16;
+    
+    for(int i = 3; i < argc; i++){
+        if(strcmp(argv[i], "--unit-bytes") == 0 && i + 1 < argc && atoi(argv[i + 1]) > 0)
+        replay.unitBytes = atoi(argv[++i]);
+        
+        else if(strcmp(argv[i], "--alignment") == 0 && i + 1 < argc)
+        replay.alignment = strtoull(argv[++i], NULL, 10);
+        
+        else
+        return 2;
+    }
+    
+    if(replay.arenaSize == 0 || replay.alignment < 8 || replay.alignment > 65536 || (replay.alignment & (replay.alignment - 1)) != 0)
+    return 1;
+    
+    return -1;
+}
+
+int main(int argc, char *argv[]){
+    ReplayOptions replay;
+    
+    if(argc < 3){
+        cout << "Usage: " << argv[0] << " <trace> <arena bytes> [--unit-bytes <n>] [--alignment <n>]" << endl;
+        return 1;
+    }
+    
+    int error = replayArgumentValidation(argc, argv, replay);
+    
+    if(error == 1){
+        cout << "The arena size must be positive, and the alignment a power of two from 8 to 65536." << endl;
+        return 1;
+    }
+    else if(error == 2){
+        cout << "An unknown replay option has been entered." << endl;
+        return 1;
+    }
+    
+    return runReplay(replay) ? 0 : 1;
+}